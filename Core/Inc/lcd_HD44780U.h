@@ -12,15 +12,112 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "lcd_HD44780U_config.h"
 
 #define arr_size(a)			(sizeof(a) / sizeof((a)[0]))
 
+//Instruction classes with their own execution time. The order matches the position of the highest set bit of the
+//instruction code, data reads and writes come last.
+typedef enum
+{
+	LCD_INSTRUCTION_CLEAR_DISPLAY,
+	LCD_INSTRUCTION_RETURN_HOME,
+	LCD_INSTRUCTION_ENTRY_MODE_SET,
+	LCD_INSTRUCTION_DISPLAY_CONTROL,
+	LCD_INSTRUCTION_SHIFT,
+	LCD_INSTRUCTION_FUNCTION_SET,
+	LCD_INSTRUCTION_SET_CGRAM_ADDRESS,
+	LCD_INSTRUCTION_SET_DDRAM_ADDRESS,
+	LCD_INSTRUCTION_WRITE_DATA,
+	LCD_INSTRUCTION_READ_DATA,
+	LCD_INSTRUCTION_CLASS_COUNT
+} LCD_InstructionClass;
+
+//Errors reported through LCD_GetLastError and LCD_ErrorCallback.
+typedef enum
+{
+	LCD_ERROR_NONE,
+	LCD_ERROR_BUSY_TIMEOUT,	//The busy flag didn't turn off in time. The driver switched to timed mode.
+	LCD_ERROR_STATE_MISMATCH,	//The tracked address counter differed from the chip's (LCD_VERIFY_ADDRESS)
+} LCD_Error;
+
+//Counters of the time spent waiting for the chip. See LCD_GetBusyStats.
+typedef struct
+{
+	uint32_t polls;				//Busy flag reads made while waiting
+	uint32_t mispredictions;	//Waits where the first poll still found the chip busy
+	uint32_t timeouts;			//Waits that gave up (LCD_BUSY_TIMEOUT_FACTOR)
+	uint32_t waitCycles;		//CPU cycles spent waiting for the chip
+	uint32_t overlappedCycles;	//Chip execution time that passed while the caller was doing something else
+	uint32_t elided;			//Instructions skipped because they wouldn't have changed anything (LCD_STATE_CACHE)
+	uint32_t firstPollCycles[LCD_INSTRUCTION_CLASS_COUNT]; //Current busy duration estimates (LCD_BUSY_PREDICTOR)
+} LCD_BusyStats;
+
+//Every display sharing the bus, for LCD_SelectDisplays.
+#define LCD_ALL_DISPLAYS	((uint8_t)((1u << LCD_DISPLAY_COUNT) - 1))
+
 //Instruction bits correspond to RS-RW-D7-D6-D5-D4-D3-D2-D1-D0 in order. Big endian. Only the lower 10 bits of the instruction are used.
 void SendInstruction(uint16_t instruction);
 
+//Returns the class of the given 10-bit instruction.
+LCD_InstructionClass LCD_ClassifyInstruction(uint16_t instruction);
+
+//Overrides how long the given instruction class keeps the chip busy. The table is used in every mode: it paces the
+//instructions when the busy flag can't be read (LCD_WRITE_ONLY or after a busy timeout), bounds busy flag waits
+//(LCD_BUSY_TIMEOUT_FACTOR), sizes burst slots (LCD_BURST) and is the default profile of every display and handle.
+//Init16x2LCD also starts the busy duration estimates from it (LCD_BUSY_PREDICTOR). The defaults come from
+//lcd_HD44780U_config.h. Controller clones with a slower oscillator need longer times.
+void SetInstructionExecutionTime(LCD_InstructionClass instructionClass, uint32_t microseconds);
+
+//Copies the busy wait counters into stats.
+void LCD_GetBusyStats(LCD_BusyStats* stats);
+
+//Zeroes the busy wait counters. The busy duration estimates are kept.
+void LCD_ResetBusyStats(void);
+
+//Waits until the chip has finished the last instruction. Functions return as soon as their instruction is on the bus
+//(LCD_PIPELINED), so use this before anything that needs the chip to be done, e.g. powering it down.
+void LCD_Wait(void);
+
+//Returns the last error since the last LCD_ClearError call.
+LCD_Error LCD_GetLastError(void);
+
+//Sets the last error back to LCD_ERROR_NONE.
+void LCD_ClearError(void);
+
+//Called on every error. Can be called from the LCD_ASYNC timer interrupt. The default implementation does nothing,
+//define it in the application to be notified.
+void LCD_ErrorCallback(LCD_Error error);
+
+//Forgets the driver's copy of the controller state (LCD_STATE_CACHE), so the next setting and address instructions
+//are sent whatever they are. For when the chip may have been reset or written to behind the driver's back.
+void LCD_InvalidateState(void);
+
+//Returns whether the driver reads the busy flag (1) or waits for the execution times (0). Becomes 0 in write-only
+//mode and after a busy timeout. Init16x2LCD tries the busy flag again.
+uint8_t LCD_UsesBusyFlag(void);
+
+//Selects the displays the following functions act on, bit n - 1 is display n (see LCD_DISPLAY_COUNT). Writes go to
+//all selected displays at once with a single strobe, so content and settings common to all of them cost the same as
+//for one display. Select a single display for content that differs, the other displays keep executing meanwhile.
+//Reads come from the lowest selected display. Init16x2LCD selects every display. Bits of displays that don't exist
+//are ignored, 0 is ignored.
+void LCD_SelectDisplays(uint8_t displays);
+
+//Returns the displays selected with LCD_SelectDisplays.
+uint8_t LCD_GetSelectedDisplays(void);
+
 //Initializes a 16x2 LCD screen. Different screens need different initializations, use this method only with 16x2 LCDs.
+//With more than one display, all of them are initialized together and left selected.
 void Init16x2LCD();
 
+#if LCD_DISPLAY_COUNT >= 2
+//Initializes a 40x4 LCD screen. These have two controllers: lines 1 and 2 are display 1 (Pin_EN), lines 3 and 4 are
+//display 2 (Pin_EN2). MoveCursor selects the controller of the line, so the other functions act on the part of the
+//screen the cursor is on. The cursor is turned off since both controllers would show one.
+void Init40x4LCD();
+#endif
+
 //Clears the entire display
 void ClearScreen();
 
@@ -37,21 +134,47 @@ void DisplayAndCursorControl(uint8_t display, uint8_t cursor, uint8_t blink);
 //Moves cursor to the right or to the left
 void ShiftCursor(uint8_t shiftRight);
 
-//Moves the cursor to the given position on the given line. 1 <= line <= 2 and 1 <= position <= 40.
+//Moves the cursor to the given position on the given line. 1 <= line <= 2 (4 after Init40x4LCD) and
+//1 <= position <= 40. Between BeginHiddenPage and ClearScreen or ReturnHome, positions count from the page being drawn
+//or shown and wrap around the line.
 void MoveCursor(uint8_t line, uint8_t position);
 
-//Returns the line the cursor is currently on. Returns 1 or 2 upon success, another value upon error.
+//Returns the line the cursor is currently on. Returns 1 or 2 (3 or 4 on the second controller of a 40x4 module) upon
+//success, another value upon error. Answered from the driver's copy of the address counter without touching the bus,
+//the chip is only read when that copy isn't known (never in write-only mode).
 uint8_t GetCurrentLine();
 
+//Gets the line and position of the cursor, as passed to MoveCursor. The position counts from the current page (see
+//BeginHiddenPage), a display shifted with ShiftDisplay isn't taken into account. Returns 0 if the cursor isn't in
+//DDRAM or its position isn't known, like GetCurrentLine.
+uint8_t GetCursorPosition(uint8_t* line, uint8_t* position);
+
 //Shifts display to the right or to the left
 void ShiftDisplay(uint8_t shiftRight);
 
-//Shifts the display to the right n times.
+//Shifts the display to the right n times. The shift wraps around after 40 positions, so this sends at most 20 shift
+//instructions, going the other way when that is shorter.
 void ShiftDisplayRight(size_t n);
 
-//Shifts the display to the left n times.
+//Shifts the display to the left n times, like ShiftDisplayRight.
 void ShiftDisplayLeft(size_t n);
 
+//Shifts the display so that the window starts at the given DDRAM column of each line (0 to 39, larger values wrap),
+//wherever it is now. Goes the shorter way around from the tracked display shift, or returns home first when that is
+//cheaper by the expected execution times or the shift isn't known (e.g. several displays with different shifts).
+//Returning home also moves the cursor home.
+void SetDisplayOffset(uint8_t offset);
+
+//Page flipping for modules of up to 20 columns, which only show part of the 40 characters of a DDRAM line. After
+//BeginHiddenPage, MoveCursor and the functions based on it write to the 20 columns right of the visible window, out
+//of view, while the current page stays on the screen. ShowHiddenPage then moves the window onto them with the display
+//shift, so the new page appears at once instead of being painted character by character, and MoveCursor keeps
+//addressing it. Pages alternate between DDRAM columns 0 and 20 and are shown with SetDisplayOffset, which takes up to
+//20 display shifts (about 0.75 ms, far below the response time of the liquid crystal). Not for 40x4 modules, which
+//show the whole line. Don't use display shifting entry modes meanwhile.
+void BeginHiddenPage();
+void ShowHiddenPage();
+
 //Sets interface data length, number of display lines and character font
 void FunctionSet(uint8_t using8Bits, uint8_t using2Lines, uint8_t using5x10Font);
 
@@ -59,6 +182,10 @@ void FunctionSet(uint8_t using8Bits, uint8_t using2Lines, uint8_t using5x10Font)
 //address counter on the chip.
 void SendByte(uint8_t byte);
 
+//Sends len bytes to the chip in a row, starting at the current address. The address counter moves by itself after
+//every byte, so the address only needs to be set once before.
+void SendBytes(const uint8_t* bytes, size_t len);
+
 //Writes the given character on the screen. The character is selected from chip's internal ROM, which supports
 //more than just ASCII characters.
 void WriteCharacter(uint8_t character);
@@ -66,6 +193,18 @@ void WriteCharacter(uint8_t character);
 //Writes the given string on the screen
 void WriteString(const char* text);
 
+//Writes len characters of text starting at the given line and position (see MoveCursor). text doesn't need to be
+//null terminated. Characters past position 40 continue on the other line.
+void WriteStringAt(uint8_t line, uint8_t position, const char* text, size_t len);
+
+#if LCD_DISPLAY_COUNT >= 2
+//Rewrites the whole screen of a 40x4 module (Init40x4LCD). text holds the 4 lines of 40 characters one after the
+//other and doesn't need to be null terminated. The two controllers are written in turns, each byte going to the one
+//that is ready first, so this takes about as long as writing one controller. The address counter of both controllers
+//wraps back to the start of their first line, the selected controller stays the same.
+void WriteScreen40x4(const char* text);
+#endif
+
 //Sets a CGRAM address for the internal address counter of the chip. CGRAM data is sent and received after this
 //setting. Only the lowest 6 bits are used.
 void SetCGRAMAddress(uint8_t address);
@@ -76,13 +215,17 @@ void SetDDRAMAddress(uint8_t address);
 
 //Returns whether the chip is busy executing an internal operation. You shouldn't need to explicitly check for this,
 //each function provided already checks if the chip is busy before sending the instruction.
+//In write-only mode, this is answered from the execution time of the last instruction.
 uint8_t IsBusy();
 
-//Reads the current address counter value of the chip.
+#if !LCD_WRITE_ONLY
+//Reads the current address counter value of the chip. Not available in write-only mode.
 uint8_t ReadAddressCounter();
 
 //Reads from the internal memory of the LCD chip. The address is determined by the chip's internal address counter.
-//Either CGRAM Address or DDRAM Address needs to be set before calling this function.
+//Either CGRAM Address or DDRAM Address needs to be set before calling this function. Not available in write-only
+//mode.
 uint8_t ReadByte();
+#endif
 
 #endif /* INC_LCD_HD44780U_H_ */
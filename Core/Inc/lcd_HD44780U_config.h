@@ -0,0 +1,166 @@
+/*
+ * lcd_HD44780U_config.h
+ *
+ *	Compile time options of the HD44780U driver. Every option can be overridden from the compiler command line
+ *	(e.g. -DLCD_ENABLE_BENCHMARK=1), the values below are only the defaults.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_HD44780U_CONFIG_H_
+#define INC_LCD_HD44780U_CONFIG_H_
+
+//When not 0, lcd_benchmark.c is compiled in and LCD_Benchmark_Run() can be used to measure the CPU cost of the
+//driver's bus access paths with the DWT cycle counter.
+#ifndef LCD_ENABLE_BENCHMARK
+#define LCD_ENABLE_BENCHMARK		0
+#endif
+
+//Set to 1 on boards where the RW line of the LCD is tied to GND. The busy flag can't be read then, so the driver
+//waits for the execution time of every instruction instead (see below) and the read functions are not available.
+//Pin_RW is not used at all in this mode.
+#ifndef LCD_WRITE_ONLY
+#define LCD_WRITE_ONLY				0
+#endif
+
+//Instruction execution times in microseconds, used in every mode (see SetInstructionExecutionTime). The defaults are
+//the datasheet values for fOSC = 270 kHz. Clones running at a lower oscillator frequency need proportionally longer times. They can also be
+//changed at runtime with SetInstructionExecutionTime.
+#ifndef LCD_EXECUTION_TIME_CLEAR_US
+#define LCD_EXECUTION_TIME_CLEAR_US			1520
+#endif
+
+#ifndef LCD_EXECUTION_TIME_RETURN_HOME_US
+#define LCD_EXECUTION_TIME_RETURN_HOME_US	1520
+#endif
+
+//Entry mode set, display control, shift, function set, CGRAM/DDRAM address set
+#ifndef LCD_EXECUTION_TIME_DEFAULT_US
+#define LCD_EXECUTION_TIME_DEFAULT_US		37
+#endif
+
+//Data write and read. Includes tADD = 4 us, after which the address counter is updated.
+#ifndef LCD_EXECUTION_TIME_DATA_US
+#define LCD_EXECUTION_TIME_DATA_US			41
+#endif
+
+//When not 0, the busy flag isn't polled right after a strobe. The driver learns how long each instruction class
+//keeps the chip busy and only starts polling around the expected completion, with exponential backoff between polls.
+//Has no effect in write-only mode.
+#ifndef LCD_BUSY_PREDICTOR
+#define LCD_BUSY_PREDICTOR					1
+#endif
+
+//Longest pause between two busy flag polls, in microseconds.
+#ifndef LCD_BUSY_PREDICTOR_MAX_BACKOFF_US
+#define LCD_BUSY_PREDICTOR_MAX_BACKOFF_US	8
+#endif
+
+//After a wait where the first poll found the chip ready, the estimate is lowered by 1/2^LCD_BUSY_PREDICTOR_CREEP_SHIFT
+//of itself. Smaller values find faster chips sooner but cause more mispredictions.
+#ifndef LCD_BUSY_PREDICTOR_CREEP_SHIFT
+#define LCD_BUSY_PREDICTOR_CREEP_SHIFT		5
+#endif
+
+//A busy flag wait gives up LCD_BUSY_TIMEOUT_FACTOR times the execution time of the pending instruction after its
+//strobe. The driver then reports LCD_ERROR_BUSY_TIMEOUT, stops reading the busy flag (waits like in write-only mode)
+//and runs the init sequence again. This bounds every wait, also when no LCD is connected. Needs to be at least 2.
+#ifndef LCD_BUSY_TIMEOUT_FACTOR
+#define LCD_BUSY_TIMEOUT_FACTOR				4
+#endif
+
+//Number of displays sharing RS, RW and D0-D7, each with its own E line (Pin_EN, Pin_EN2, ... in main.h). Up to 8.
+//See LCD_SelectDisplays.
+#ifndef LCD_DISPLAY_COUNT
+#define LCD_DISPLAY_COUNT					1
+#endif
+
+//When not 0, functions return right after their instruction is strobed and the wait for the chip happens at the
+//start of the next bus access. The caller's own work in between overlaps with the chip's execution time (see
+//overlappedCycles in LCD_BusyStats). When 0, every instruction is waited for before its function returns.
+#ifndef LCD_PIPELINED
+#define LCD_PIPELINED						1
+#endif
+
+//When not 0, the driver skips instructions that wouldn't change the state of the selected controllers: entry mode,
+//display control and function set equal to the current ones, an address set to where the address counter already is,
+//return home while it is home already. The state is tracked in software, see LCD_InvalidateState.
+#ifndef LCD_STATE_CACHE
+#define LCD_STATE_CACHE						1
+#endif
+
+//Debug option: when not 0, GetCurrentLine and GetCursorPosition read the address counter from the chip as well and
+//report LCD_ERROR_STATE_MISMATCH if it differs from the tracked one. Costs a busy wait and a read per call. Has no
+//effect in write-only mode.
+#ifndef LCD_VERIFY_ADDRESS
+#define LCD_VERIFY_ADDRESS					0
+#endif
+
+//When not 0, lcd_async.c is compiled in. After LCD_Async_Init(), instructions are put into a queue and sent to the
+//chip from the TIM7 interrupt, so none of the write functions block. See lcd_async.h.
+#ifndef LCD_ASYNC
+#define LCD_ASYNC							0
+#endif
+
+//Number of instructions the queue can hold. Needs to be a power of 2.
+#ifndef LCD_ASYNC_QUEUE_SIZE
+#define LCD_ASYNC_QUEUE_SIZE				64
+#endif
+
+//NVIC preemption priority of the TIM7 interrupt. USB OTG runs at 0 and should stay above the LCD.
+#ifndef LCD_ASYNC_IRQ_PRIORITY
+#define LCD_ASYNC_IRQ_PRIORITY				5
+#endif
+
+//When not 0, lcd_burst.c is compiled in: whole instruction streams are sent by DMA, paced by TIM8. See lcd_burst.h.
+#ifndef LCD_BURST
+#define LCD_BURST							0
+#endif
+
+//Number of timer slots a burst can use. A slot is the execution time of one data write, longer instructions (clear,
+//return home) take more than one. Every slot needs 16 bytes of RAM.
+#ifndef LCD_BURST_MAX_SLOTS
+#define LCD_BURST_MAX_SLOTS					128
+#endif
+
+//When not 0, lcd_trace.c is compiled in and every bus access of the driver is recorded with its cycle stamp, to be
+//dumped over USB CDC. See lcd_trace.h.
+#ifndef LCD_TRACE
+#define LCD_TRACE							0
+#endif
+
+//Number of records the trace keeps, older ones are overwritten. Needs to be a power of 2. Every record needs 12 bytes
+//of RAM.
+#ifndef LCD_TRACE_BUFFER_SIZE
+#define LCD_TRACE_BUFFER_SIZE				1024
+#endif
+
+//When not 0, busy flag reads get their own trace records. Otherwise they are only counted in the next record.
+#ifndef LCD_TRACE_POLLS
+#define LCD_TRACE_POLLS						0
+#endif
+
+//When not 0, lcd_framebuffer.c is compiled in: a RAM copy of the DDRAM that only sends the characters that changed.
+//See lcd_framebuffer.h.
+#ifndef LCD_FRAMEBUFFER
+#define LCD_FRAMEBUFFER						0
+#endif
+
+//When not 0, lcd_handle.c is compiled in: an LCD_Handle per display on the shared bus, with its own geometry, timing
+//profile and instruction queue, serviced in turns by LCD_Handles_Service. See lcd_handle.h.
+#ifndef LCD_HANDLES
+#define LCD_HANDLES							0
+#endif
+
+//Number of instructions each handle can queue. Needs to be a power of 2. Every slot needs 2 bytes of RAM.
+#ifndef LCD_HANDLE_QUEUE_SIZE
+#define LCD_HANDLE_QUEUE_SIZE				64
+#endif
+
+//When not 0, lcd_marquee.c is compiled in: scrolling text on both lines with the hardware display shift. See
+//lcd_marquee.h.
+#ifndef LCD_MARQUEE
+#define LCD_MARQUEE							0
+#endif
+
+#endif /* INC_LCD_HD44780U_CONFIG_H_ */
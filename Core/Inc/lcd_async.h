@@ -0,0 +1,55 @@
+/*
+ * lcd_async.h
+ *
+ *	Non-blocking mode of the HD44780U driver. Once LCD_Async_Init() is called, every function of lcd_HD44780U.h that
+ *	writes to the chip puts its instruction into a queue and returns immediately. The TIM7 interrupt then sends the
+ *	queued instructions one by one, waiting for the chip in between without blocking anything else.
+ *	Functions that read from the chip (ReadByte, ReadAddressCounter) first wait until the queue is empty, so they
+ *	still block. Only available when LCD_ASYNC is not 0.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_ASYNC_H_
+#define INC_LCD_ASYNC_H_
+
+#include <stdint.h>
+#include "lcd_HD44780U_config.h"
+
+#if LCD_ASYNC
+
+//Called from the timer interrupt every time the chip finishes a queued instruction.
+typedef void (*LCD_Async_Callback)(uint16_t instruction);
+
+//Sets up TIM7 and switches the driver to the queue. Call it after Init16x2LCD.
+void LCD_Async_Init(void);
+
+//Returns whether LCD_Async_Init has been called.
+uint8_t LCD_Async_IsActive(void);
+
+//Queues the given 10-bit instruction and returns its ticket, see LCD_Async_IsComplete. If the queue is full, waits
+//for a free slot. Must not be called from an interrupt with a priority at or above LCD_ASYNC_IRQ_PRIORITY.
+uint32_t LCD_Async_Enqueue(uint16_t instruction);
+
+//Returns the ticket of the last queued instruction. Can be used after the regular API functions to know when
+//the instructions they queued have been executed.
+uint32_t LCD_Async_LastTicket(void);
+
+//Returns whether the instruction with the given ticket has been executed by the chip.
+uint8_t LCD_Async_IsComplete(uint32_t ticket);
+
+//Returns whether the queue is empty and the chip has finished the last instruction.
+uint8_t LCD_Async_IsIdle(void);
+
+//Waits until LCD_Async_IsIdle.
+void LCD_Async_Flush(void);
+
+//Sets the function called after each executed instruction. Pass NULL to remove it.
+void LCD_Async_SetCallback(LCD_Async_Callback callback);
+
+//Must be called from TIM7_IRQHandler.
+void LCD_Async_TimerIRQHandler(void);
+
+#endif /* LCD_ASYNC */
+
+#endif /* INC_LCD_ASYNC_H_ */
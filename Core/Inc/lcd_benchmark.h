@@ -0,0 +1,58 @@
+/*
+ * lcd_benchmark.h
+ *
+ *	On-target measurements of the HD44780U driver's CPU cost. Only available when LCD_ENABLE_BENCHMARK is not 0.
+ *	All results are in CPU cycles and are averaged over LCD_BENCHMARK_ITERATIONS runs. Read them with the debugger
+ *	or send them over USB CDC.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_BENCHMARK_H_
+#define INC_LCD_BENCHMARK_H_
+
+#include <stdint.h>
+#include "lcd_HD44780U_config.h"
+
+#if LCD_ENABLE_BENCHMARK
+
+#define LCD_BENCHMARK_ITERATIONS	64
+
+typedef struct
+{
+	uint32_t halWriteCycles;	//One instruction written with HAL_GPIO_WritePin calls (the old path, kept as reference)
+	uint32_t busWriteCycles;	//One instruction written with the driver's bus path
+	uint32_t isBusyCycles;		//One busy flag poll
+	uint32_t perByteWaitCycles;	//A 16 character line written the old way: a second busy wait and tADD after every byte
+	uint32_t writeStringCycles;	//The same line with WriteStringAt, start to finish
+#if LCD_DISPLAY_COUNT >= 2
+	uint32_t sequential40x4Cycles;	//A full 40x4 screen written line by line with WriteStringAt
+	uint32_t screen40x4Cycles;		//The same screen with WriteScreen40x4, the controllers interleaved
+#endif
+#if LCD_FRAMEBUFFER
+	uint32_t dashboardRewriteCycles;	//A 16x2 screen where 3 digits changed, both lines rewritten with WriteStringAt
+	uint32_t dashboardFlushCycles;		//The same update through the framebuffer with LCD_Flush
+	uint32_t dashboardFlushWrites;		//Instructions LCD_Flush sent for it (34 for the rewrite)
+	uint32_t corpusRunsCycles;			//All screen transitions of the corpus in lcd_benchmark.c with LCD_FlushRuns
+	uint32_t corpusRunsWrites;			//Instructions sent for them
+	uint32_t corpusPlannedCycles;		//The same transitions with the planned LCD_Flush
+	uint32_t corpusPlannedWrites;
+	uint32_t pageFlipCycles;			//The page change flushed with BeginHiddenPage and shown with ShowHiddenPage
+	uint32_t pageFlipWrites;			//Instructions LCD_Flush sent for it
+	uint32_t pageFlipIntact;			//1 if the flush left the page hidden until ShowHiddenPage
+#endif
+#if LCD_BURST
+	uint32_t burstCpuCycles;	//CPU time to build and start the same line as a DMA burst
+	uint32_t burstTotalCycles;	//Start of the burst until the chip has finished the last character
+#endif
+} LCD_BenchmarkResults;
+
+//Runs every measurement and stores the results. The LCD (and the burst engine, if enabled) needs to be initialized.
+//Overwrites the first line of the display. With LCD_DISPLAY_COUNT >= 2 the 40x4 measurements overwrite the whole
+//screen, they are only meaningful after Init40x4LCD. The framebuffer measurements overwrite both lines and leave the
+//framebuffer in sync with them, the display returned home.
+void LCD_Benchmark_Run(LCD_BenchmarkResults* results);
+
+#endif /* LCD_ENABLE_BENCHMARK */
+
+#endif /* INC_LCD_BENCHMARK_H_ */
@@ -0,0 +1,47 @@
+/*
+ * lcd_burst.h
+ *
+ *	DMA driven bursts of instructions. The BSRR words for a whole instruction stream are computed up front, then TIM8
+ *	paces two DMA2 streams that write them to the data and control ports: data and RS/RW setup, EN high and EN low
+ *	for every instruction, followed by the instruction's execution time. Once started, a burst needs no CPU at all.
+ *
+ *	The burst is open loop: it paces instructions by the execution time table (see SetInstructionExecutionTime)
+ *	instead of the busy flag, so the table has to be right for the connected chip.
+ *	Only available when LCD_BURST is not 0. Uses TIM8, DMA2 Stream 1 (TIM8_UP) and DMA2 Stream 2 (TIM8_CH1/2/3).
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_BURST_H_
+#define INC_LCD_BURST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lcd_HD44780U_config.h"
+
+#if LCD_BURST
+
+//Sets up TIM8 and DMA2. Call it after Init16x2LCD.
+void LCD_Burst_Init(void);
+
+//Waits for the chip (and the async queue, if it is used), converts the given 10-bit write instructions to bus words
+//and starts sending them. Returns 1 when the burst was started, 0 if a burst is already running, the instructions
+//need more than LCD_BURST_MAX_SLOTS slots or one of them is a read.
+//The burst goes to the displays selected at the start (LCD_SelectDisplays), keep the selection until it is done.
+//Meanwhile, the driver's blocking functions wait for the burst before they touch the bus, IsBusy returns 1, and the
+//LCD_ASYNC queue and LCD_Handles_Service hold their instructions back. Blocking functions must not be called from an
+//interrupt at or above LCD_ASYNC_IRQ_PRIORITY during a burst, the burst's DMA interrupt couldn't end it.
+uint8_t LCD_Burst_Start(const uint16_t* instructions, size_t count);
+
+//Returns whether a burst is still being sent.
+uint8_t LCD_Burst_IsBusy(void);
+
+//Waits until the running burst has been sent.
+void LCD_Burst_Wait(void);
+
+//Must be called from DMA2_Stream2_IRQHandler.
+void LCD_Burst_DMAIRQHandler(void);
+
+#endif /* LCD_BURST */
+
+#endif /* INC_LCD_BURST_H_ */
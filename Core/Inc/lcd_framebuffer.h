@@ -0,0 +1,76 @@
+/*
+ * lcd_framebuffer.h
+ *
+ *	Double buffered RAM copy of the chip's DDRAM (2 lines of 40 characters, visible or not). The application renders
+ *	into the back buffer at its own pace and commits it when the frame is complete. The commit swaps the buffers, and
+ *	LCD_Flush then compares the committed frame with what the DDRAM holds and sends only the characters that differ:
+ *	one DDRAM address set per run of changed characters followed by the characters themselves (the address counter moves
+ *	by itself). Updating a few digits of a screen costs a few bus writes instead of rewriting whole lines, and a frame
+ *	that is still being rendered never reaches the screen. Only available when LCD_FRAMEBUFFER is not 0.
+ *
+ *	Render and commit from thread mode. LCD_Flush can run there as well, or in an interrupt where the driver's write
+ *	functions can be used (e.g. with LCD_ASYNC, at a lower priority than LCD_ASYNC_IRQ_PRIORITY). It relies on the
+ *	entry mode being increment without display shift (the init default) and leaves the cursor after the last character
+ *	it sent. With several displays, it writes to the selected ones.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_FRAMEBUFFER_H_
+#define INC_LCD_FRAMEBUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lcd_HD44780U_config.h"
+
+#if LCD_FRAMEBUFFER
+
+#define LCD_FRAMEBUFFER_LINES		2
+#define LCD_FRAMEBUFFER_COLUMNS		40
+
+//Starts over from a cleared screen: every character of both buffers is a space and nothing needs to be sent. Call it
+//after Init16x2LCD or ClearScreen.
+void LCD_Framebuffer_Init(void);
+
+//Writes len characters of text into the back buffer at the given line and position (1 <= line <= 2,
+//1 <= position <= 40). text doesn't need to be null terminated. Characters past position 40 are dropped.
+void LCD_Framebuffer_Write(uint8_t line, uint8_t position, const char* text, size_t len);
+
+//Sets every character of the back buffer to the given one.
+void LCD_Framebuffer_Fill(char character);
+
+//Returns the character of the back buffer at the given line and position.
+char LCD_Framebuffer_GetChar(uint8_t line, uint8_t position);
+
+//Makes the back buffer the frame LCD_Flush sends. The new back buffer starts as a copy of it, so the next frame only
+//needs to write what changes. A frame committed before the previous one was flushed replaces it.
+void LCD_Framebuffer_Commit(void);
+
+//Forgets what the DDRAM holds, so the next LCD_Flush sends every character. For when something else wrote to the
+//DDRAM (e.g. WriteStringAt) or the chip was reset.
+void LCD_Framebuffer_Invalidate(void);
+
+//Returns whether LCD_Flush may have anything to send.
+uint8_t LCD_Framebuffer_IsDirty(void);
+
+//Sends the characters of the committed frame that differ from the DDRAM. The instructions are planned with the
+//expected busy time of each instruction class: clean characters between changed ones are written again when that is
+//cheaper than an address set, the first changed character is reached from where the cursor is when that is cheaper,
+//and the screen is cleared first when that is cheaper than writing all the characters that become spaces. Return home
+//and clear are only used while the display isn't shifted. Returns the number of instructions sent.
+uint32_t LCD_Flush(void);
+
+//Like LCD_Flush, but only sends what fits in the given time, counting every instruction with its execution time. The
+//rest is left for the next call, so the main loop can update the display a bit at a time at a bounded cost. Changed
+//characters are sent in the order they changed in (a whole run of them at once), so none waits for more than the
+//ones before it. A budget below one character write sends nothing. Returns the number of instructions sent.
+uint32_t LCD_FlushFor(uint32_t microseconds);
+
+#if LCD_ENABLE_BENCHMARK
+//LCD_Flush without the planning: every run of changed characters gets an address set. For comparison only.
+uint32_t LCD_FlushRuns(void);
+#endif
+
+#endif /* LCD_FRAMEBUFFER */
+
+#endif /* INC_LCD_FRAMEBUFFER_H_ */
@@ -0,0 +1,79 @@
+/*
+ * lcd_handle.h
+ *
+ *	Handle based API for boards with several displays on the shared bus (see LCD_DISPLAY_COUNT). Every display gets an
+ *	LCD_Handle with its own geometry, execution time profile and instruction queue. The functions below only queue
+ *	instructions and never wait. LCD_Handles_Service then sends them, one instruction per handle in turns, skipping
+ *	displays that are still busy, so the execution time of one display is spent serving the others. Only available
+ *	when LCD_HANDLES is not 0.
+ *
+ *	The bus and all displays are set up by Init16x2LCD first. The regular API keeps working on the selected displays
+ *	next to the handles, and whatever the LCD_ASYNC queue holds is sent before the handles are serviced. All functions
+ *	are for thread mode only.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_HANDLE_H_
+#define INC_LCD_HANDLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <lcd_HD44780U.h>
+
+#if LCD_HANDLES
+
+typedef struct LCD_Handle
+{
+	//Configuration
+	uint8_t display;		//Display number on the bus, 1 is Pin_EN, n is Pin_ENn
+	uint8_t columns;		//Visible characters per line
+	uint8_t lines;			//1, 2, or 4 for a 20x4 module (lines 3 and 4 continue lines 1 and 2 in DDRAM)
+	uint32_t executionCycles[LCD_INSTRUCTION_CLASS_COUNT]; //Timing profile, see LCD_Handle_SetExecutionTime
+
+	//Queued instructions, head and tail are free running
+	uint16_t queue[LCD_HANDLE_QUEUE_SIZE];
+	uint32_t head;
+	uint32_t tail;
+
+	struct LCD_Handle* next; //Scheduler list
+} LCD_Handle;
+
+//Sets up the handle for the given display (1 to LCD_DISPLAY_COUNT) and size, adds it to the scheduler and queues the
+//init sequence for its geometry: display on, cursor off, increment, cleared screen. The timing profile starts from the
+//driver's execution time table. Returns 0 if the display number is out of range.
+uint8_t LCD_Handle_Init(LCD_Handle* handle, uint8_t display, uint8_t columns, uint8_t lines);
+
+//Overrides how long the given instruction class keeps this handle's controller busy, e.g. for a slower clone.
+void LCD_Handle_SetExecutionTime(LCD_Handle* handle, LCD_InstructionClass instructionClass, uint32_t microseconds);
+
+//Queues a 10-bit instruction (see SendInstruction). Returns 0 if the queue is full.
+uint8_t LCD_Handle_Enqueue(LCD_Handle* handle, uint16_t instruction);
+
+//Number of instructions that can still be queued.
+size_t LCD_Handle_FreeSlots(const LCD_Handle* handle);
+
+//Returns whether every queued instruction has been sent.
+uint8_t LCD_Handle_IsIdle(const LCD_Handle* handle);
+
+//The functions below queue the instruction(s) of their counterparts in lcd_HD44780U.h for the handle's display.
+//They return 0 if the queue doesn't have room for all of them, in which case nothing is queued.
+uint8_t LCD_Handle_ClearScreen(LCD_Handle* handle);
+uint8_t LCD_Handle_ReturnHome(LCD_Handle* handle);
+uint8_t LCD_Handle_EntryModeSet(LCD_Handle* handle, uint8_t increment, uint8_t shiftDisplay);
+uint8_t LCD_Handle_DisplayAndCursorControl(LCD_Handle* handle, uint8_t display, uint8_t cursor, uint8_t blink);
+uint8_t LCD_Handle_MoveCursor(LCD_Handle* handle, uint8_t line, uint8_t position);
+uint8_t LCD_Handle_Write(LCD_Handle* handle, const char* text, size_t len);
+uint8_t LCD_Handle_WriteAt(LCD_Handle* handle, uint8_t line, uint8_t position, const char* text, size_t len);
+
+//Sends queued instructions to every display that is ready, one per handle in turns, until all handles are either
+//empty or waiting for their display. Never waits for a display. Call it often, e.g. from the main loop. Returns the
+//number of instructions sent.
+uint32_t LCD_Handles_Service(void);
+
+//Calls LCD_Handles_Service until every queue is empty.
+void LCD_Handles_Flush(void);
+
+#endif /* LCD_HANDLES */
+
+#endif /* INC_LCD_HANDLE_H_ */
@@ -0,0 +1,44 @@
+/*
+ * lcd_marquee.h
+ *
+ *	Scrolling tickers on both lines of a 16x2 or 20x2 module. Every DDRAM line is a ring of 40 characters of which the
+ *	module shows a window. The text of a scrolling line is streamed into the ring ahead of the window, and every scroll
+ *	step moves the window by one with a single display shift. Only the column that has just scrolled out of view is
+ *	written again, with the character that is furthest ahead, so a step costs a shift, an address set and one character
+ *	however long the text is. Only available when LCD_MARQUEE is not 0.
+ *
+ *	The display shift moves both lines at once. The scrolling line with the shortest period leads it, the other line
+ *	keeps its own speed (or stands still) by being redrawn within the window whenever it or the window moves, with only
+ *	the characters that differ written. That costs up to a window's width of characters per step, so lines scrolling
+ *	at the same period are cheapest. Call LCD_Marquee_Service often, from the main loop or from a timer interrupt where
+ *	the driver's write functions can be used (see lcd_framebuffer.h). The marquee owns the DDRAM while it runs, don't
+ *	write to it or shift the display meanwhile.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_MARQUEE_H_
+#define INC_LCD_MARQUEE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lcd_HD44780U_config.h"
+
+#if LCD_MARQUEE
+
+//Starts the marquee on a module with the given number of visible columns (1 to 39) and both lines empty. Returns the
+//display home, sets the entry mode to increment without display shift and forgets what the DDRAM holds.
+void LCD_Marquee_Init(uint8_t columns);
+
+//Shows len characters of text on the given line (1 or 2). A line with a period scrolls left by one character every
+//periodMs milliseconds and starts over after the last character, so the text should end with the gap to show before
+//it comes again. A period of 0 shows the text from the start of the window, padded with spaces. text isn't copied and
+//has to stay valid while it is shown, it doesn't need to be null terminated.
+void LCD_Marquee_SetLine(uint8_t line, const char* text, size_t len, uint32_t periodMs);
+
+//Takes the scroll steps that are due and writes what they change. Returns the number of instructions sent.
+uint32_t LCD_Marquee_Service(void);
+
+#endif /* LCD_MARQUEE */
+
+#endif /* INC_LCD_MARQUEE_H_ */
@@ -0,0 +1,78 @@
+/*
+ * lcd_trace.h
+ *
+ *	Bus trace of the HD44780U driver. Every instruction strobed on the bus and every read from the chip is recorded
+ *	into a RAM ring buffer with its DWT cycle stamp and the time spent waiting for the chip before it. The buffer can
+ *	be sent over USB CDC and decoded on the host with Tools/lcd_trace_decode.py. Only available when LCD_TRACE is
+ *	not 0.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef INC_LCD_TRACE_H_
+#define INC_LCD_TRACE_H_
+
+#include <stdint.h>
+#include "lcd_HD44780U_config.h"
+
+#if LCD_TRACE
+
+#define LCD_TRACE_MAGIC				"LCDT"
+#define LCD_TRACE_VERSION			1
+
+//Flags in the upper bits of LCD_TraceRecord.word. The lower 10 bits are the instruction (RS, RW, D7-D0). For reads,
+//D7-D0 are the value read from the chip.
+#define LCD_TRACE_INSTRUCTION_MASK	0x03FF
+#define LCD_TRACE_FLAG_TIMEOUT		(1 << 10)	//The wait before this access timed out
+#define LCD_TRACE_FLAG_INTERRUPT	(1 << 11)	//Issued from an interrupt (LCD_ASYNC)
+#define LCD_TRACE_FLAG_BURST		(1 << 12)	//Sent by DMA (LCD_BURST), cycles is the scheduled time of the strobe
+
+//One bus access, 12 bytes. Sent over USB as is (little endian).
+typedef struct
+{
+	uint32_t cycles;		//DWT cycle stamp of the EN rising edge
+	uint32_t waitCycles;	//Cycles spent waiting for the chip since the previous record
+	uint16_t polls;			//Busy flag reads made since the previous record
+	uint16_t word;			//Instruction and flags, see above
+} LCD_TraceRecord;
+
+//Sent before the records in a dump, 20 bytes.
+typedef struct __attribute__((packed))
+{
+	char magic[4];			//LCD_TRACE_MAGIC
+	uint8_t version;		//LCD_TRACE_VERSION
+	uint8_t recordSize;		//sizeof(LCD_TraceRecord)
+	uint16_t reserved;
+	uint32_t coreClockHz;	//To convert cycle counts to time
+	uint32_t recordCount;	//Number of records following the header, oldest first
+	uint32_t dropped;		//Records overwritten since the last clear
+} LCD_TraceHeader;
+
+//Turns recording on or off. Recording is on from startup.
+void LCD_Trace_Enable(uint8_t enable);
+
+//Drops every record.
+void LCD_Trace_Clear(void);
+
+//Copies up to maxRecords records into records, oldest first. Returns the number copied.
+uint32_t LCD_Trace_Read(LCD_TraceRecord* records, uint32_t maxRecords);
+
+//Sends a header and every record over USB CDC, then clears the buffer. Recording is paused meanwhile. Blocks until
+//the transfer is done. Returns 0 if USB isn't connected or the host doesn't read the data.
+uint8_t LCD_Trace_Dump(void);
+
+//Asks for a dump from an interrupt (e.g. the CDC receive callback). The dump is done by LCD_Trace_Process.
+void LCD_Trace_RequestDump(void);
+
+//Does a requested dump. Call it from the main loop.
+void LCD_Trace_Process(void);
+
+//Driver hooks, not meant to be called by the application.
+//Adds a wait to the next record.
+void LCD_Trace_Wait(uint32_t waitCycles, uint32_t polls, uint8_t timedOut);
+//Records an access that started at the given cycle stamp. flags are added to the ones set by the driver state.
+void LCD_Trace_Access(uint16_t instruction, uint32_t cycles, uint16_t flags);
+
+#endif /* LCD_TRACE */
+
+#endif /* INC_LCD_TRACE_H_ */
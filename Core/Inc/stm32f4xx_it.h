@@ -57,6 +57,8 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 void OTG_FS_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void TIM7_IRQHandler(void);
+void DMA2_Stream2_IRQHandler(void);
 
 /* USER CODE END EFP */
 
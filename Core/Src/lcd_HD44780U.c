@@ -6,6 +6,11 @@
  */
 
 #include <lcd_HD44780U.h>
+#include "lcd_HD44780U_internal.h"
+#include "lcd_HD44780U_pinmap.h"
+#include <lcd_async.h>
+#include <lcd_burst.h>
+#include <lcd_trace.h>
 #include "main.h"
 #include <string.h>
 
@@ -22,108 +27,893 @@ static void DWT_Init(void)
 	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; //Enable the cycle counter
 }
 
-static void DWT_delay_us(uint32_t delay)
+//Bus timings from the datasheet, in nanoseconds (Vcc = 4.5 V to 5.5 V).
+static const uint32_t tAS_NS = 40;		//RS/RW setup before EN rises
+static const uint32_t PWEH_NS = 230;	//EN high pulse width
+static const uint32_t tAH_NS = 10;		//RS/RW/data hold after EN falls (tAH and tH, tDHR is 5 ns)
+static const uint32_t tDDR_NS = 160;	//Data valid after EN rises during a read (max)
+static const uint32_t tCYCE_NS = 500;	//EN rising edge to the next EN rising edge
+static const uint32_t tADD_NS = 4000;	//Address counter update after the busy flag turns off
+
+LCD_Timing lcdTiming;
+
+//Cycle stamp of the last EN rising edge, for tcycE.
+static uint32_t lastEnableRise;
+
+//How long each instruction class keeps the chip busy, in microseconds. Used instead of the busy flag in timed mode.
+static uint32_t executionTimes[LCD_INSTRUCTION_CLASS_COUNT] =
+{
+	[LCD_INSTRUCTION_CLEAR_DISPLAY] = LCD_EXECUTION_TIME_CLEAR_US,
+	[LCD_INSTRUCTION_RETURN_HOME] = LCD_EXECUTION_TIME_RETURN_HOME_US,
+	[LCD_INSTRUCTION_ENTRY_MODE_SET] = LCD_EXECUTION_TIME_DEFAULT_US,
+	[LCD_INSTRUCTION_DISPLAY_CONTROL] = LCD_EXECUTION_TIME_DEFAULT_US,
+	[LCD_INSTRUCTION_SHIFT] = LCD_EXECUTION_TIME_DEFAULT_US,
+	[LCD_INSTRUCTION_FUNCTION_SET] = LCD_EXECUTION_TIME_DEFAULT_US,
+	[LCD_INSTRUCTION_SET_CGRAM_ADDRESS] = LCD_EXECUTION_TIME_DEFAULT_US,
+	[LCD_INSTRUCTION_SET_DDRAM_ADDRESS] = LCD_EXECUTION_TIME_DEFAULT_US,
+	[LCD_INSTRUCTION_WRITE_DATA] = LCD_EXECUTION_TIME_DATA_US,
+	[LCD_INSTRUCTION_READ_DATA] = LCD_EXECUTION_TIME_DATA_US,
+};
+
+//The same table converted to CPU cycles.
+static uint32_t executionCycles[LCD_INSTRUCTION_CLASS_COUNT];
+
+//Execution time table of each display, in CPU cycles. Displays with their own timing profile (LCD_Handle) point to
+//theirs, the others to executionCycles.
+static const uint32_t* displayCycles[LCD_DISPLAY_COUNT] =
+{
+	[0 ... LCD_DISPLAY_COUNT - 1] = executionCycles,
+};
+
+//The instruction a display is currently executing: when it was issued, its class and how long it takes.
+//instructionClass is LCD_INSTRUCTION_CLASS_COUNT while nothing has been issued yet, and once the instruction has been
+//waited for.
+typedef struct
+{
+	uint32_t issuedAt;
+	LCD_InstructionClass instructionClass;
+	uint32_t cycles;
+} PendingInstruction;
+
+//One per display, the displays sharing the bus execute independently of each other.
+static PendingInstruction pending[LCD_DISPLAY_COUNT] =
+{
+	[0 ... LCD_DISPLAY_COUNT - 1] = { .instructionClass = LCD_INSTRUCTION_CLASS_COUNT },
+};
+
+//Displays the bus accesses go to (bit n - 1 is display n) and their E lines. Written by the LCD_ASYNC interrupt while
+//the queue is in use, requestedDisplays is what the application last selected.
+static volatile uint8_t selectedDisplays = LCD_ALL_DISPLAYS;
+static volatile uint16_t selectedEnablePins = LCD_ALL_ENABLE_PINS;
+static uint8_t requestedDisplays = LCD_ALL_DISPLAYS;
+
+//Lines of the connected module: 2, or 4 for a 40x4 module, where lines 3 and 4 belong to the second controller.
+static uint8_t lineCount = 2;
+
+//Columns of a page (BeginHiddenPage): half of a DDRAM line, enough for a 20 column module.
+static const uint8_t PAGE_COLUMNS = 20;
+//DDRAM column that position 1 of MoveCursor is in. Only moves with the pages of BeginHiddenPage and ShowHiddenPage,
+//it is 0 otherwise.
+static uint8_t columnOrigin;
+
+//Software copy of what each controller has been told, as of the last instruction sent or queued for it. The
+//instruction bytes are kept as they were sent, 0 means unknown (e.g. before init or after a reset by instruction).
+typedef struct
+{
+	uint8_t functionSet;
+	uint8_t displayControl;
+	uint8_t entryMode;
+	uint8_t address;		//Set address instruction leading to the address counter: 0x80 | DDRAM or 0x40 | CGRAM address
+	uint8_t shift;			//Display shift, in positions to the left modulo 40. Only valid when shiftKnown is set.
+	uint8_t shiftKnown;
+} ControllerState;
+
+static ControllerState controllerState[LCD_DISPLAY_COUNT];
+
+#if LCD_BUSY_PREDICTOR
+//Per instruction class, how many cycles after the strobe the first busy flag poll is made. Starts from the
+//execution time table and follows the measured busy durations afterwards.
+static uint32_t firstPollCycles[LCD_INSTRUCTION_CLASS_COUNT];
+#endif
+
+static LCD_BusyStats busyStats;
+
+#if LCD_WRITE_ONLY
+static const uint8_t useBusyFlag = 0;
+#else
+//When 0, the driver waits for executionTimes instead of reading the busy flag. Also cleared from the LCD_ASYNC
+//interrupt when the busy flag times out.
+static volatile uint8_t useBusyFlag = 1;
+
+//Set by a busy timeout until the init sequence has been run again.
+static volatile uint8_t recoveryPending;
+//Set while the init sequence is run again, so the waits in it don't start another one.
+static uint8_t recovering;
+
+_Static_assert(LCD_BUSY_TIMEOUT_FACTOR >= 2, "The busy timeout needs to leave room for slow chips");
+#endif
+
+static volatile LCD_Error lastError = LCD_ERROR_NONE;
+
+uint32_t LCD_NanosecondsToCycles(uint32_t ns)
+{
+	//Round up so that every datasheet minimum is met at any core clock.
+	return (uint32_t)(((uint64_t)ns * lcdTiming.coreClockHz + 999999999u) / 1000000000u);
+}
+
+//Reads the core clock once and converts every bus timing to CPU cycles, so the bus paths only compare cycle counts.
+static void TimingInit(void)
+{
+	lcdTiming.coreClockHz = HAL_RCC_GetHCLKFreq();
+	lcdTiming.cyclesPerMicrosecond = lcdTiming.coreClockHz / 1000000;
+	lcdTiming.tAS = LCD_NanosecondsToCycles(tAS_NS);
+	lcdTiming.PWeh = LCD_NanosecondsToCycles(PWEH_NS);
+	lcdTiming.tAH = LCD_NanosecondsToCycles(tAH_NS);
+	lcdTiming.tDDR = LCD_NanosecondsToCycles(tDDR_NS);
+	lcdTiming.tcycE = LCD_NanosecondsToCycles(tCYCE_NS);
+	lcdTiming.tADD = LCD_NanosecondsToCycles(tADD_NS);
+
+	for (size_t i = 0; i < arr_size(executionCycles); i++)
+	{
+		executionCycles[i] = executionTimes[i] * lcdTiming.cyclesPerMicrosecond;
+#if LCD_BUSY_PREDICTOR
+		firstPollCycles[i] = executionCycles[i];
+#endif
+	}
+}
+
+LCD_InstructionClass LCD_ClassifyInstruction(uint16_t instruction)
+{
+	if (instruction & (1 << 9)) //RS
+	{
+		return (instruction & (1 << 8)) ? LCD_INSTRUCTION_READ_DATA : LCD_INSTRUCTION_WRITE_DATA;
+	}
+	uint8_t byte = (uint8_t)instruction;
+	if (byte == 0)
+	{
+		//Not a valid instruction, treat it like the slowest one to stay on the safe side.
+		return LCD_INSTRUCTION_CLEAR_DISPLAY;
+	}
+	//The instruction is selected by its highest set bit, and the enum follows the same order.
+	return (LCD_InstructionClass)(31 - __CLZ(byte));
+}
+
+static void MarkDisplayIssued(uint8_t display, uint16_t instruction, uint32_t now)
+{
+	PendingInstruction* p = &pending[display];
+	p->issuedAt = now;
+	p->instructionClass = LCD_ClassifyInstruction(instruction);
+	p->cycles = displayCycles[display][p->instructionClass];
+}
+
+void LCD_MarkIssued(uint16_t instruction)
+{
+	uint32_t now = LCD_Now();
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if (selectedDisplays & (1 << display))
+		{
+			MarkDisplayIssued(display, instruction, now);
+		}
+	}
+}
+
+void LCD_ApplyDisplaySelection(uint8_t displays)
+{
+	uint16_t enablePins = 0;
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if (displays & (1 << display))
+		{
+			enablePins |= LCD_ENABLE_PINS[display];
+		}
+	}
+	selectedDisplays = displays;
+	selectedEnablePins = enablePins;
+}
+
+uint16_t LCD_SelectedEnablePins(void)
+{
+	return selectedEnablePins;
+}
+
+void LCD_SelectDisplays(uint8_t displays)
+{
+	displays &= LCD_ALL_DISPLAYS;
+	if (displays == 0)
+	{
+		return;
+	}
+	requestedDisplays = displays;
+#if LCD_ASYNC
+	if (LCD_Async_IsActive())
+	{
+		//Takes effect in the queue, after the instructions queued before
+		LCD_Async_Enqueue(LCD_ASYNC_SELECT_DISPLAYS | displays);
+		return;
+	}
+#endif
+	LCD_ApplyDisplaySelection(displays);
+}
+
+uint8_t LCD_GetSelectedDisplays(void)
+{
+	return requestedDisplays;
+}
+
+//Moves the tracked address counter the way the chip does after a data access or a cursor shift. In 2-line mode the
+//DDRAM lines are 0x00-0x27 and 0x40-0x67 and each continues with the other one, in 1-line mode it is one line of 80.
+static void StepAddress(ControllerState* state, uint8_t forward)
+{
+	if (state->address & 0x80)
+	{
+		uint8_t address = state->address & 0x7F;
+		if (state->functionSet == 0)
+		{
+			state->address = 0; //Depends on the line mode
+			return;
+		}
+		if (state->functionSet & (1 << 3))
+		{
+			if (address > 0x67 || (address > 0x27 && address < 0x40))
+			{
+				state->address = 0; //Not a DDRAM address in 2-line mode
+				return;
+			}
+			if (forward)
+			{
+				address = (address == 0x27) ? 0x40 : (address == 0x67) ? 0x00 : address + 1;
+			}
+			else
+			{
+				address = (address == 0x00) ? 0x67 : (address == 0x40) ? 0x27 : address - 1;
+			}
+		}
+		else
+		{
+			if (address > 0x4F)
+			{
+				state->address = 0;
+				return;
+			}
+			address = forward ? ((address == 0x4F) ? 0x00 : address + 1) : ((address == 0x00) ? 0x4F : address - 1);
+		}
+		state->address = 0x80 | address;
+	}
+	else if (state->address & 0x40)
+	{
+		state->address = 0x40 | ((state->address + (forward ? 1 : -1)) & 0x3F);
+	}
+}
+
+//Shifts the tracked display shift by one position, to the left or to the right.
+static void StepShift(ControllerState* state, uint8_t left)
+{
+	state->shift = left ? ((state->shift + 1) % 40) : ((state->shift + 39) % 40);
+}
+
+//Applies what the given instruction does to the tracked state of a controller.
+static void TrackInstruction(ControllerState* state, uint16_t instruction)
+{
+	uint8_t byte = (uint8_t)instruction;
+	switch (LCD_ClassifyInstruction(instruction))
+	{
+	case LCD_INSTRUCTION_CLEAR_DISPLAY:
+		state->address = 0x80;
+		state->shift = 0;
+		state->shiftKnown = 1;
+		if (state->entryMode != 0)
+		{
+			state->entryMode |= (1 << 1); //Clearing also sets increment
+		}
+		break;
+	case LCD_INSTRUCTION_RETURN_HOME:
+		state->address = 0x80;
+		state->shift = 0;
+		state->shiftKnown = 1;
+		break;
+	case LCD_INSTRUCTION_ENTRY_MODE_SET:
+		state->entryMode = byte;
+		break;
+	case LCD_INSTRUCTION_DISPLAY_CONTROL:
+		state->displayControl = byte;
+		break;
+	case LCD_INSTRUCTION_SHIFT:
+		if (byte & (1 << 3))
+		{
+			StepShift(state, !(byte & (1 << 2)));
+		}
+		else
+		{
+			StepAddress(state, byte & (1 << 2));
+		}
+		break;
+	case LCD_INSTRUCTION_FUNCTION_SET:
+		state->functionSet = byte;
+		break;
+	case LCD_INSTRUCTION_SET_CGRAM_ADDRESS:
+	case LCD_INSTRUCTION_SET_DDRAM_ADDRESS:
+		state->address = byte;
+		break;
+	case LCD_INSTRUCTION_WRITE_DATA:
+	case LCD_INSTRUCTION_READ_DATA:
+		if (state->entryMode == 0)
+		{
+			state->address = 0;
+			state->shiftKnown = 0;
+			break;
+		}
+		StepAddress(state, state->entryMode & (1 << 1));
+		//With display shift on, DDRAM writes shift the display along with the cursor
+		if ((state->entryMode & (1 << 0)) && !(instruction & (1 << 8)))
+		{
+			if (state->address & 0x80)
+			{
+				StepShift(state, state->entryMode & (1 << 1));
+			}
+			else if (state->address == 0)
+			{
+				state->shiftKnown = 0; //Can't tell whether it was a DDRAM write
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void LCD_TrackInstruction(uint8_t displays, uint16_t instruction)
+{
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if (displays & (1 << display))
+		{
+			TrackInstruction(&controllerState[display], instruction);
+		}
+	}
+}
+
+//Returns whether the given instruction would leave the controller exactly as it is.
+static uint8_t InstructionRedundant(const ControllerState* state, uint16_t instruction)
+{
+	uint8_t byte = (uint8_t)instruction;
+	switch (LCD_ClassifyInstruction(instruction))
+	{
+	case LCD_INSTRUCTION_RETURN_HOME:
+		return state->address == 0x80 && state->shiftKnown && state->shift == 0;
+	case LCD_INSTRUCTION_ENTRY_MODE_SET:
+		return state->entryMode == byte;
+	case LCD_INSTRUCTION_DISPLAY_CONTROL:
+		return state->displayControl == byte;
+	case LCD_INSTRUCTION_FUNCTION_SET:
+		return state->functionSet == byte;
+	case LCD_INSTRUCTION_SET_CGRAM_ADDRESS:
+	case LCD_INSTRUCTION_SET_DDRAM_ADDRESS:
+		return state->address == byte;
+	default:
+		return 0; //Clearing, shifting and data accesses always do something
+	}
+}
+
+//Returns whether the given instruction would leave every given display as it is.
+static uint8_t RedundantForDisplays(uint8_t displays, uint16_t instruction)
+{
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if ((displays & (1 << display)) && !InstructionRedundant(&controllerState[display], instruction))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void LCD_InvalidateState(void)
+{
+	memset(controllerState, 0, sizeof(controllerState));
+}
+
+uint32_t LCD_ExecutionCycles(LCD_InstructionClass instructionClass)
+{
+	return executionCycles[instructionClass];
+}
+
+uint32_t LCD_ExpectedCycles(LCD_InstructionClass instructionClass)
+{
+#if LCD_BUSY_PREDICTOR
+	if (useBusyFlag)
+	{
+		return firstPollCycles[instructionClass];
+	}
+#endif
+	return executionCycles[instructionClass];
+}
+
+uint8_t LCD_GetColumnOrigin(void)
 {
-	uint32_t start = DWT->CYCCNT;
-	uint32_t cpuCyclesPerMicrosecond = HAL_RCC_GetHCLKFreq() / 1000000;
-	uint32_t requiredCycles = delay * cpuCyclesPerMicrosecond;
+	return columnOrigin;
+}
+
+uint8_t LCD_GetDisplayShift(uint8_t* shift)
+{
+	uint8_t found = 0;
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		const ControllerState* state = &controllerState[display];
+		if (requestedDisplays & (1 << display))
+		{
+			if (!state->shiftKnown || (found && state->shift != *shift))
+			{
+				return 0;
+			}
+			*shift = state->shift;
+			found = 1;
+		}
+	}
+	return found;
+}
+
+void LCD_SetDisplayExecutionCycles(uint8_t display, const uint32_t* cycles)
+{
+	displayCycles[display] = (cycles != NULL) ? cycles : executionCycles;
+}
+
+void SetInstructionExecutionTime(LCD_InstructionClass instructionClass, uint32_t microseconds)
+{
+	if (instructionClass >= LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		return;
+	}
+	executionTimes[instructionClass] = microseconds;
+	executionCycles[instructionClass] = microseconds * lcdTiming.cyclesPerMicrosecond;
+}
 
-	//Wait until enough cycles has passed
-	while ((DWT->CYCCNT - start) < requiredCycles) { }
+//Raises the given E lines once tcycE has passed since the previous rising edge. Returns the cycle stamp of the edge.
+static inline uint32_t RaiseEnable(uint16_t enablePins)
+{
+	LCD_WaitSince(lastEnableRise, lcdTiming.tcycE);
+	LCD_CONTROL_PORT->BSRR = enablePins;
+	lastEnableRise = LCD_Now();
+	return lastEnableRise;
 }
 
-//For input, pass GPIO_MODE_INPUT. For output, pass GPIO_MODE_OUTPUT_PP.
-static void ChangeGPIOPortEMode(uint32_t mode)
+typedef enum
+{
+	BUS_DIRECTION_UNKNOWN,
+	BUS_DIRECTION_INPUT,
+	BUS_DIRECTION_OUTPUT,
+} BusDirection;
+
+//Direction the data bus pins are currently configured in. Only the MODER bits of the data pins are touched when
+//switching, everything else (speed, pull, output type) is configured once by InitDataBus.
+static BusDirection dataBusDirection = BUS_DIRECTION_UNKNOWN;
+
+//Configures the data pins once as push-pull outputs with no pull resistors.
+static void InitDataBus(void)
 {
 	GPIO_InitTypeDef gpioInit = { 0 };
-	gpioInit.Pin = Pin_D0_Pin | Pin_D1_Pin | Pin_D2_Pin | Pin_D3_Pin |
-				   Pin_D4_Pin | Pin_D5_Pin | Pin_D6_Pin | Pin_D7_Pin;
-	gpioInit.Mode = mode;
+	gpioInit.Pin = LCD_DATA_PINS_A;
+	gpioInit.Mode = GPIO_MODE_OUTPUT_PP;
 	gpioInit.Pull = GPIO_NOPULL;
 	gpioInit.Speed = GPIO_SPEED_FREQ_LOW;
 
-	HAL_GPIO_Init(GPIOE, &gpioInit);
+	HAL_GPIO_Init(LCD_DATA_PORT_A, &gpioInit);
+	if (LCD_DATA_USES_PORT_B)
+	{
+		gpioInit.Pin = LCD_DATA_PINS_B;
+		HAL_GPIO_Init(LCD_DATA_PORT_B, &gpioInit);
+	}
+	dataBusDirection = BUS_DIRECTION_OUTPUT;
+}
+
+//Switches the data bus direction with a single masked MODER write per data port. Does nothing if the bus already is
+//in the requested direction, so back to back busy flag polls don't pay for it.
+static void SetDataBusDirection(BusDirection direction)
+{
+	if (direction == dataBusDirection)
+	{
+		return;
+	}
+
+	LCD_SetDataBusMode(direction == BUS_DIRECTION_OUTPUT);
+	dataBusDirection = direction;
 }
 
-//This function expects which read operation needs to be done to already be specified. e.g. if you
-//want to check for the busy flag, you need to set RS=low RW=high before calling this function.
-static uint8_t ReadLCDMemory_Internal()
+#if !LCD_WRITE_ONLY
+//What a read returns. The busy flag and the address counter are read together (RS=0), the target only tells the trace
+//what the read was for.
+typedef enum
+{
+	READ_BUSY_FLAG,
+	READ_ADDRESS_COUNTER,
+	READ_RAM,
+} ReadTarget;
+
+//Sets RS and RW for the given read and reads the data bus of the given display once. Only one display can drive the
+//bus at a time.
+static uint8_t ReadLCDMemory_Internal(ReadTarget target, uint8_t display)
 {
 	//Do NOT wait until busy flag turns off here. In order to read the busy flag, this function needs to
 	//be called. If this function checks for busy flag as well, we have infinite recursion and eventual
 	//stack overflow.
 
-	ChangeGPIOPortEMode(GPIO_MODE_INPUT);
-	//Here RS and RW are already set. Before enable pin is used, tAS time needs to pass.
-	//In case the caller didn't do it, add the delay here.
-	uint32_t tAS = 1; //This is 40 ns minimum. We have a resolution of us, so wait 1 us.
-	DWT_delay_us(tAS);
-
-	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_SET);
-	uint32_t tDDR = 1; //This is 160 ns (max). Since we have 1 us precision, wait for 1 us.
-	DWT_delay_us(tDDR); //Wait until data becomes valid.
-	//NOTE: The enable signal also needs to stay high for at least PWeh = 230 ns. Since we are
-	//waiting 1 us, it includes this delay as well so we don't need to bother with it.
-
-	uint8_t value = 0;
-	value |= HAL_GPIO_ReadPin(Pin_D7_GPIO_Port, Pin_D7_Pin) << 7;
-	value |= HAL_GPIO_ReadPin(Pin_D6_GPIO_Port, Pin_D6_Pin) << 6;
-	value |= HAL_GPIO_ReadPin(Pin_D5_GPIO_Port, Pin_D5_Pin) << 5;
-	value |= HAL_GPIO_ReadPin(Pin_D4_GPIO_Port, Pin_D4_Pin) << 4;
-	value |= HAL_GPIO_ReadPin(Pin_D3_GPIO_Port, Pin_D3_Pin) << 3;
-	value |= HAL_GPIO_ReadPin(Pin_D2_GPIO_Port, Pin_D2_Pin) << 2;
-	value |= HAL_GPIO_ReadPin(Pin_D1_GPIO_Port, Pin_D1_Pin) << 1;
-	value |= HAL_GPIO_ReadPin(Pin_D0_GPIO_Port, Pin_D0_Pin) << 0;
-
-	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_RESET);
-	//After enable is set low, the data/address is held for tDHR and tAH respectively. The minimum values of
-	//these are 5ns min and 10ns min. Waiting a whole microsecond is very wasteful, so just wait 100 clock
-	//cycles with NOP.
-	for (int i = 0; i < 100; i++)
-	{
-		__NOP();
-	}
-	ChangeGPIOPortEMode(GPIO_MODE_OUTPUT_PP);
+	uint16_t instruction = (target == READ_RAM) ? 0b1100000000 : 0b0100000000;
+	LCD_CONTROL_PORT->BSRR = LCD_CONTROL_BSRR[instruction >> 8];
+	SetDataBusDirection(BUS_DIRECTION_INPUT);
+	//Before enable pin is used, tAS time needs to pass after RS and RW are set.
+	LCD_DelayCycles(lcdTiming.tAS);
+
+	uint32_t enableRise = RaiseEnable(LCD_ENABLE_PINS[display]);
+	LCD_DelayCycles(lcdTiming.tDDR); //Wait until data becomes valid.
+
+	//All data lines of a port are sampled at the same instant with a single IDR read
+	uint8_t value = LCD_ReadDataBus();
 
+	//The enable signal also needs to stay high for at least PWeh in total.
+	LCD_WaitSince(enableRise, lcdTiming.PWeh);
+	LCD_CONTROL_PORT->BSRR = BSRR_RESET(LCD_ALL_ENABLE_PINS);
+	//After enable is set low, the data/address is held for tDHR and tAH respectively.
+	LCD_DelayCycles(lcdTiming.tAH);
+	//The bus is left as an input. The next write switches it back, consecutive reads don't switch at all.
+
+#if LCD_TRACE
+	if (LCD_TRACE_POLLS || target != READ_BUSY_FLAG)
+	{
+		LCD_Trace_Access(instruction | value, enableRise, 0);
+	}
+#endif
 	return value;
 }
+#endif
 
-void SendInstruction(uint16_t instruction)
+void LCD_WriteBus(uint16_t instruction)
 {
-	while (IsBusy()) { }
+	//RS, RW and EN (EN low) and the data bus, one store per port.
+	LCD_PutInstruction(instruction);
+	//After RS and RW are set to desired values, tAS needs to pass before enable pin is set HIGH.
+	LCD_DelayCycles(lcdTiming.tAS);
+	//Toggle enable pin. It needs to stay high for PWeh, which also covers the data setup time tDSW = 80 ns.
+	//Every selected display latches the same instruction, a broadcast costs the same as a single write.
+	uint32_t enableRise = RaiseEnable(selectedEnablePins);
+	LCD_WaitSince(enableRise, lcdTiming.PWeh);
+	LCD_CONTROL_PORT->BSRR = BSRR_RESET(LCD_ALL_ENABLE_PINS);
+	LCD_MarkIssued(instruction);
+#if LCD_TRACE
+	LCD_Trace_Access(instruction, enableRise, 0);
+#endif
+	//After enable pin is set LOW, both the address and the data lines need to be held for tAH and tH.
+	LCD_DelayCycles(lcdTiming.tAH);
+}
 
-	ChangeGPIOPortEMode(GPIO_MODE_OUTPUT_PP);
-	GPIO_TypeDef* ports[] = { Pin_RS_GPIO_Port, Pin_RW_GPIO_Port, Pin_D7_GPIO_Port, Pin_D6_GPIO_Port,
-							  Pin_D5_GPIO_Port, Pin_D4_GPIO_Port, Pin_D3_GPIO_Port, Pin_D2_GPIO_Port,
-							  Pin_D1_GPIO_Port, Pin_D0_GPIO_Port };
+static uint8_t ChipBusy(uint8_t display);
+#if !LCD_WRITE_ONLY
+static void Recover(void);
+#endif
 
-	uint16_t pins[] 	  = { Pin_RS_Pin, Pin_RW_Pin, Pin_D7_Pin, Pin_D6_Pin, Pin_D5_Pin,
-			                  Pin_D4_Pin, Pin_D3_Pin, Pin_D2_Pin, Pin_D1_Pin, Pin_D0_Pin };
-	for (int i = 0; i < arr_size(pins); i++)
+//How long the pending instruction is expected to keep the chip busy, in cycles from its strobe.
+static uint32_t ExpectedBusyCycles(const PendingInstruction* p)
+{
+#if LCD_BUSY_PREDICTOR
+	if (useBusyFlag)
 	{
-		HAL_GPIO_WritePin(ports[i], pins[i], (instruction >> ((arr_size(pins) - 1) - i)) & 0x1);
+		return firstPollCycles[p->instructionClass];
 	}
-	//After RS and RW are set to desired values, tAS = 40 ns min needs to pass before enable pin is set HIGH.
-	//Our resolution is in us, so wait 1 us.
-	uint32_t tAS = 1;
-	DWT_delay_us(tAS);
-	//Toggle enable pin
-	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_SET);
-	//After enable pin is set HIGH, tDSW = 80 ns min needs to pass.
-	//Our resolution is in microseconds, so wait 1 us.
-	uint32_t tDSW = 1;
-	DWT_delay_us(tDSW);
-	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_RESET);
-	//After enable pin is set LOW, both the address and the data lines are held by the chip
-	//for tAH and tH respectively, both of them are 10 ns min. Waiting 1 microsecond is very wasteful, so
-	//just wait for 100 clock cycles using NOP.
-	for (int i = 0; i < 100; i++)
+#endif
+	return p->cycles;
+}
+
+#if !LCD_WRITE_ONLY
+//How long after the strobe of the pending instruction the busy flag wait gives up. Without a pending instruction
+//(power on, after a read) the longest execution time is used.
+static uint32_t BusyTimeoutCycles(const PendingInstruction* p)
+{
+	uint32_t cycles = (p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT) ?
+		p->cycles : executionCycles[LCD_INSTRUCTION_CLEAR_DISPLAY];
+	return cycles * LCD_BUSY_TIMEOUT_FACTOR;
+}
+
+//The busy flag is stuck or there is no chip: report it and wait for the execution times from now on. This can run
+//in the LCD_ASYNC interrupt, so the init sequence is only flagged here and run by the next wait in thread mode.
+static void BusyTimedOut(void)
+{
+	useBusyFlag = 0;
+	recoveryPending = 1;
+	busyStats.timeouts++;
+	lastError = LCD_ERROR_BUSY_TIMEOUT;
+	LCD_ErrorCallback(LCD_ERROR_BUSY_TIMEOUT);
+}
+
+//Polls the busy flag of the given display until it turns off. Without the predictor, polling starts right away.
+//With it, the bus is left alone until shortly before the pending instruction is expected to finish, polls are spaced
+//out with an exponential backoff and the expectation is corrected with what was observed.
+//Gives up after BusyTimeoutCycles, so a missing or hung chip can't stall the caller.
+static void WaitForBusyFlag(uint8_t display)
+{
+	const PendingInstruction* p = &pending[display];
+	uint32_t polls = 1;
+	uint32_t since = (p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT) ? p->issuedAt : LCD_Now();
+	uint32_t timeout = BusyTimeoutCycles(p);
+	uint8_t timedOut = 0;
+#if LCD_BUSY_PREDICTOR
+	uint8_t arrivedEarly = 0;
+	if (p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		uint32_t firstPoll = firstPollCycles[p->instructionClass];
+		arrivedEarly = (LCD_Now() - p->issuedAt) < firstPoll;
+		LCD_WaitSince(p->issuedAt, firstPoll);
+	}
+
+	uint32_t backoff = lcdTiming.cyclesPerMicrosecond;
+	uint32_t maxBackoff = LCD_BUSY_PREDICTOR_MAX_BACKOFF_US * lcdTiming.cyclesPerMicrosecond;
+	while (ChipBusy(display))
 	{
-		__NOP();
+		if ((LCD_Now() - since) > timeout)
+		{
+			timedOut = 1;
+			break;
+		}
+		polls++;
+		LCD_DelayCycles(backoff);
+		if (backoff < maxBackoff)
+		{
+			backoff *= 2;
+		}
+	}
+
+	if (!timedOut && p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		uint32_t* firstPoll = &firstPollCycles[p->instructionClass];
+		if (polls > 1)
+		{
+			//Polled too early. The chip finished somewhere before now, move halfway there.
+			busyStats.mispredictions++;
+			uint32_t elapsed = LCD_Now() - p->issuedAt;
+			*firstPoll += (elapsed - *firstPoll) / 2;
+		}
+		else if (arrivedEarly)
+		{
+			//The first poll found the chip ready, it may have been ready even earlier. Creep towards it.
+			*firstPoll -= *firstPoll >> LCD_BUSY_PREDICTOR_CREEP_SHIFT;
+		}
+		//A caller that only came back after the predicted time tells nothing about the busy duration.
+	}
+#else
+	while (ChipBusy(display))
+	{
+		if ((LCD_Now() - since) > timeout)
+		{
+			timedOut = 1;
+			break;
+		}
+		polls++;
+	}
+#endif
+	busyStats.polls += polls;
+	if (timedOut)
+	{
+		BusyTimedOut();
 	}
 }
+#endif
 
-void Init16x2LCD()
+//Cycles until the given display is expected to be done with its pending instruction, 0 if it should be already.
+static uint32_t DisplayRemainingCycles(uint8_t display, uint32_t now)
+{
+	const PendingInstruction* p = &pending[display];
+	if (p->instructionClass >= LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		return 0;
+	}
+	uint32_t expected = ExpectedBusyCycles(p);
+	uint32_t elapsed = now - p->issuedAt;
+	return (elapsed < expected) ? (expected - elapsed) : 0;
+}
+
+//Waits until the given display can accept the next instruction.
+static void WaitForDisplay(uint8_t display, uint32_t now)
+{
+	PendingInstruction* p = &pending[display];
+	if (p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		uint32_t elapsed = now - p->issuedAt;
+		uint32_t expected = ExpectedBusyCycles(p);
+		busyStats.overlappedCycles += (elapsed < expected) ? elapsed : expected;
+	}
+
+	if (useBusyFlag)
+	{
+#if !LCD_WRITE_ONLY
+		WaitForBusyFlag(display);
+#endif
+	}
+	else if (p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		LCD_WaitSince(p->issuedAt, p->cycles);
+	}
+	//Only one wait is needed per instruction, later waits find the chip ready right away.
+	p->instructionClass = LCD_INSTRUCTION_CLASS_COUNT;
+}
+
+//Waits until every selected display can accept the next instruction.
+//This is the only place the driver waits for the chip, and it is called right before the next bus access rather than
+//after a strobe. Whatever the caller did between the two ran in parallel with the chip. Displays that aren't
+//selected keep executing, so writes to one display overlap with the execution on the others.
+static void WaitUntilReady(void)
+{
+#if LCD_BURST
+	//DMA drives the bus until the burst is done, the chip's pending instruction is its last one
+	LCD_Burst_Wait();
+#endif
+#if LCD_TRACE
+	uint32_t pollsBefore = busyStats.polls;
+	uint32_t timeoutsBefore = busyStats.timeouts;
+#endif
+	uint32_t start = LCD_Now();
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if (selectedDisplays & (1 << display))
+		{
+			WaitForDisplay(display, start);
+		}
+	}
+	uint32_t waited = LCD_Now() - start;
+	busyStats.waitCycles += waited;
+#if LCD_TRACE
+	LCD_Trace_Wait(waited, busyStats.polls - pollsBefore, busyStats.timeouts != timeoutsBefore);
+#endif
+#if !LCD_WRITE_ONLY
+	if (recoveryPending && !recovering)
+	{
+		Recover();
+	}
+#endif
+}
+
+void LCD_Wait(void)
+{
+#if LCD_ASYNC
+	if (LCD_Async_IsActive())
+	{
+		LCD_Async_Flush();
+		return;
+	}
+#endif
+	WaitUntilReady();
+}
+
+void LCD_GetBusyStats(LCD_BusyStats* stats)
+{
+	*stats = busyStats;
+#if LCD_BUSY_PREDICTOR
+	for (size_t i = 0; i < arr_size(firstPollCycles); i++)
+	{
+		stats->firstPollCycles[i] = firstPollCycles[i];
+	}
+#endif
+}
+
+uint32_t LCD_ElidedInstructions(void)
+{
+	return busyStats.elided;
+}
+
+void LCD_ResetBusyStats(void)
+{
+	busyStats = (LCD_BusyStats){ 0 };
+}
+
+LCD_Error LCD_GetLastError(void)
+{
+	return lastError;
+}
+
+void LCD_ClearError(void)
+{
+	lastError = LCD_ERROR_NONE;
+}
+
+__weak void LCD_ErrorCallback(LCD_Error error)
+{
+	UNUSED(error);
+	//NOTE: This function should not be modified, when the callback is needed, LCD_ErrorCallback can be implemented
+	//in the user file.
+}
+
+uint8_t LCD_UsesBusyFlag(void)
+{
+	return useBusyFlag;
+}
+
+void LCD_PrepareWrite(void)
+{
+	WaitUntilReady();
+	SetDataBusDirection(BUS_DIRECTION_OUTPUT);
+}
+
+void SendInstruction(uint16_t instruction)
+{
+#if !LCD_WRITE_ONLY
+	//Thread mode part of a busy timeout, e.g. one that happened in the LCD_ASYNC interrupt. The re-init forgets the
+	//tracked state, so it has to be done before this instruction is checked against it and tracked.
+	if (recoveryPending && !recovering)
+	{
+		Recover();
+	}
+#endif
+	//The state is tracked when the instruction is issued rather than strobed, so it also covers what is still queued
+#if LCD_STATE_CACHE
+	if (RedundantForDisplays(requestedDisplays, instruction))
+	{
+		busyStats.elided++;
+		return;
+	}
+#endif
+	LCD_TrackInstruction(requestedDisplays, instruction);
+#if LCD_ASYNC
+	if (LCD_Async_IsActive())
+	{
+		LCD_Async_Enqueue(instruction);
+		return;
+	}
+#endif
+	LCD_PrepareWrite();
+	LCD_WriteBus(instruction);
+#if !LCD_PIPELINED
+	WaitUntilReady();
+#endif
+}
+
+//The datasheet's "initializing by instruction" sequence. Without the busy flag there is no way to know whether the
+//internal reset circuit did its job, so the chip is put into 8-bit mode explicitly with the specified waits.
+static void ResetByInstruction(void)
+{
+	static const uint16_t FUNCTION_SET_8_BITS = 0b0000110000;
+	static const uint32_t waitsUs[] = { 4100, 100, 0 };
+
+	SetDataBusDirection(BUS_DIRECTION_OUTPUT);
+	for (size_t i = 0; i < arr_size(waitsUs); i++)
+	{
+		LCD_WriteBus(FUNCTION_SET_8_BITS);
+		LCD_DelayCycles(waitsUs[i] * lcdTiming.cyclesPerMicrosecond);
+	}
+	//Everything but the interface length is left as it was, which isn't known
+	LCD_InvalidateState();
+}
+
+//Configuration part of the init sequence: 8-bit 2-line mode, display and cursor on, increment, cleared screen.
+//A 40x4 module would show a cursor on both controllers, so the cursor stays off there.
+static void InitSequence(void)
+{
+	FunctionSet(1, 1, 0);
+	DisplayAndCursorControl(1, lineCount == 2, 0);
+	EntryModeSet(1, 0);
+	ClearScreen();
+}
+
+#if !LCD_WRITE_ONLY
+//Runs the init sequence again after a busy timeout, in timed mode. Whatever state the chip is in (e.g. it was
+//unplugged or lost power), it is reset by instruction first. The display content and settings are lost.
+static void Recover(void)
+{
+	recovering = 1;
+#if LCD_ASYNC
+	LCD_Async_Flush(); //Bounded, the interrupt is in timed mode as well
+#endif
+	//All displays are brought back, the application's selection is restored afterwards
+	uint8_t displays = requestedDisplays;
+	requestedDisplays = LCD_ALL_DISPLAYS;
+	LCD_ApplyDisplaySelection(LCD_ALL_DISPLAYS);
+	ResetByInstruction();
+	WaitUntilReady(); //The queue starts strobing right away, the last reset step needs to be over
+	InitSequence();
+	LCD_SelectDisplays(displays);
+	recoveryPending = 0;
+	recovering = 0;
+}
+#endif
+
+//Init16x2LCD and Init40x4LCD, which only differ in the number of lines.
+static void InitModule(uint8_t lines)
 {
 	/*
 		HD44780U has an internal reset circuitry that automatically initializes the screen
@@ -137,26 +927,57 @@ void Init16x2LCD()
 	//Give the chip 10ms to complete internal initialization + 2ms headroom.
 	//If this function isn't called when the system is starting, this delay won't be necessary. But
 	//just to make sure this function works no matter where it is called from, introduce a delay anyways.
-	HAL_Delay(12);
+	//Initializing by instruction (without the busy flag) needs more than 15ms instead.
+#if !LCD_WRITE_ONLY
+	//The busy flag is given another chance after a timeout. If the chip doesn't answer, the first wait below times
+	//out, which also leaves enough time for the recovery's reset by instruction.
+	useBusyFlag = 1;
+	recoveryPending = 0;
+#endif
+	HAL_Delay(useBusyFlag ? 12 : 16);
 
 	//Enable this before sending any instructions because instruction sending
-	//relies on microsecond delays, for which DWT needs to be enabled.
+	//relies on cycle accurate delays, for which DWT needs to be enabled.
 	DWT_Init();
+	TimingInit();
+	InitDataBus();
+	//Every display gets the same init sequence at once. Whatever they were told before may be gone.
+	LCD_SelectDisplays(LCD_ALL_DISPLAYS);
+	LCD_InvalidateState();
 
-	FunctionSet(1, 1, 0);
-	DisplayAndCursorControl(1, 1, 0);
-	EntryModeSet(1, 0);
-	ClearScreen();
+	if (!useBusyFlag)
+	{
+		ResetByInstruction();
+	}
+	lineCount = lines;
+	columnOrigin = 0;
+	InitSequence();
+}
+
+void Init16x2LCD()
+{
+	InitModule(2);
 }
 
+#if LCD_DISPLAY_COUNT >= 2
+void Init40x4LCD()
+{
+	//Both controllers get the same init sequence at once, then the cursor goes to line 1.
+	InitModule(4);
+	LCD_SelectDisplays(0b01);
+}
+#endif
+
 void ClearScreen()
 {
 	SendInstruction(0b0000000001);
+	columnOrigin = 0; //The display isn't shifted anymore
 }
 
 void ReturnHome()
 {
 	SendInstruction(0b0000000010);
+	columnOrigin = 0;
 }
 
 void EntryModeSet(uint8_t increment, uint8_t shiftDisplay)
@@ -209,9 +1030,9 @@ void MoveCursor(uint8_t line, uint8_t position)
 	{
 		line = 1;
 	}
-	else if (line > 2)
+	else if (line > lineCount)
 	{
-		line = 2;
+		line = lineCount;
 	}
 
 	if (position < 1)
@@ -223,21 +1044,93 @@ void MoveCursor(uint8_t line, uint8_t position)
 		position = 40;
 	}
 
-	SetDDRAMAddress(arr[line - 1] + position - 1); //Subtract 1 because the addresses start from 0 and the screen lines and rows start from 1.
+#if LCD_DISPLAY_COUNT >= 2
+	if (lineCount == 4)
+	{
+		//Lines 3 and 4 are lines 1 and 2 of the second controller
+		LCD_SelectDisplays((line <= 2) ? 0b01 : 0b10);
+		line = ((line - 1) % 2) + 1;
+	}
+#endif
+	//Subtract 1 because the addresses start from 0 and the screen lines and rows start from 1. The position counts from
+	//the current page and wraps around the line.
+	SetDDRAMAddress(arr[line - 1] + (columnOrigin + position - 1) % 40);
 }
 
-uint8_t GetCurrentLine()
+#if LCD_VERIFY_ADDRESS && !LCD_WRITE_ONLY
+//Compares the tracked address counter of the lowest selected display with the chip's. A difference means the
+//tracking missed something, it is reported and the chip's value is taken over.
+static void VerifyAddress(void)
 {
-	uint8_t ac = ReadAddressCounter();
-	if (ac >= FIRST_LINE_START_ADDRESS_IN_DDRAM && ac <= FIRST_LINE_END_ADDRESS_IN_DDRAM)
+	ControllerState* state = &controllerState[__builtin_ctz(requestedDisplays)];
+	if (state->address == 0)
 	{
-		return 1;
+		return;
 	}
-	else if (ac >= SECOND_LINE_START_ADDRESS_IN_DDRAM && ac <= SECOND_LINE_END_ADDRESS_IN_DDRAM)
+	uint8_t tracked = state->address & ((state->address & 0x80) ? 0x7F : 0x3F);
+	uint8_t address = ReadAddressCounter();
+	if (address != tracked)
 	{
-		return 2;
+		state->address = (state->address & 0xC0) | address;
+		lastError = LCD_ERROR_STATE_MISMATCH;
+		LCD_ErrorCallback(LCD_ERROR_STATE_MISMATCH);
 	}
-	return 255;
+}
+#endif
+
+uint8_t GetCursorPosition(uint8_t* line, uint8_t* position)
+{
+#if LCD_VERIFY_ADDRESS && !LCD_WRITE_ONLY
+	VerifyAddress();
+#endif
+	//The lowest selected display, like reads
+	uint8_t tracked = controllerState[__builtin_ctz(requestedDisplays)].address;
+	uint8_t address;
+	if (tracked & 0x80)
+	{
+		address = tracked & 0x7F;
+	}
+	else if (tracked != 0)
+	{
+		return 0; //In CGRAM
+	}
+	else
+	{
+#if LCD_WRITE_ONLY
+		return 0;
+#else
+		//Not tracked (e.g. before init), the chip knows
+		address = ReadAddressCounter();
+#endif
+	}
+
+	//On a 40x4 module, the second controller has lines 3 and 4
+	uint8_t firstLine = (lineCount == 4 && !(requestedDisplays & 0b01)) ? 3 : 1;
+	uint8_t column;
+	if (address >= FIRST_LINE_START_ADDRESS_IN_DDRAM && address <= FIRST_LINE_END_ADDRESS_IN_DDRAM)
+	{
+		*line = firstLine;
+		column = address - FIRST_LINE_START_ADDRESS_IN_DDRAM;
+	}
+	else if (address >= SECOND_LINE_START_ADDRESS_IN_DDRAM && address <= SECOND_LINE_END_ADDRESS_IN_DDRAM)
+	{
+		*line = firstLine + 1;
+		column = address - SECOND_LINE_START_ADDRESS_IN_DDRAM;
+	}
+	else
+	{
+		return 0;
+	}
+	//Counted from the current page, like MoveCursor
+	*position = (column + 40 - columnOrigin) % 40 + 1;
+	return 1;
+}
+
+uint8_t GetCurrentLine()
+{
+	uint8_t line;
+	uint8_t position;
+	return GetCursorPosition(&line, &position) ? line : 255;
 }
 
 void ShiftDisplay(uint8_t shiftRight)
@@ -250,20 +1143,73 @@ void ShiftDisplay(uint8_t shiftRight)
 	SendInstruction(instruction);
 }
 
-void ShiftDisplayRight(size_t n)
+//Shifts the display the given number of positions to the left (0 to 39) the shorter way around the line: 40 shifts
+//in one direction bring it back to where it was.
+static void ShiftDisplayBy(uint8_t left)
 {
-	for (size_t i = 0; i < n; i++)
+	if (left <= 20)
+	{
+		for (uint8_t i = 0; i < left; i++)
+		{
+			ShiftDisplay(0);
+		}
+	}
+	else
 	{
-		ShiftDisplay(1);
+		for (uint8_t i = left; i < 40; i++)
+		{
+			ShiftDisplay(1);
+		}
 	}
 }
 
+void ShiftDisplayRight(size_t n)
+{
+	ShiftDisplayBy((40 - n % 40) % 40);
+}
+
 void ShiftDisplayLeft(size_t n)
 {
-	for (size_t i = 0; i < n; i++)
+	ShiftDisplayBy(n % 40);
+}
+
+void SetDisplayOffset(uint8_t offset)
+{
+	offset %= 40;
+	//Shifts needed from home, either way around
+	uint8_t fromHome = (offset <= 20) ? offset : 40 - offset;
+	uint32_t shiftCycles = LCD_ExpectedCycles(LCD_INSTRUCTION_SHIFT);
+
+	uint8_t shift;
+	if (LCD_GetDisplayShift(&shift))
+	{
+		uint8_t left = (offset + 40 - shift) % 40;
+		uint8_t steps = (left <= 20) ? left : 40 - left;
+		if (steps * shiftCycles <= LCD_ExpectedCycles(LCD_INSTRUCTION_RETURN_HOME) + fromHome * shiftCycles)
+		{
+			ShiftDisplayBy(left);
+			return;
+		}
+	}
+
+	//Return home is where the shift is known to be 0, also when the tracked one isn't known
+	SendInstruction(0b0000000010);
+	ShiftDisplayBy(offset);
+}
+
+void BeginHiddenPage()
+{
+	uint8_t shift;
+	if (!LCD_GetDisplayShift(&shift))
 	{
-		ShiftDisplay(0);
+		shift = 0; //ShowHiddenPage returns home first
 	}
+	columnOrigin = (shift + PAGE_COLUMNS) % 40;
+}
+
+void ShowHiddenPage()
+{
+	SetDisplayOffset(columnOrigin);
 }
 
 void FunctionSet(uint8_t using8Bits, uint8_t using2Lines, uint8_t using5x10Font)
@@ -286,18 +1232,20 @@ void FunctionSet(uint8_t using8Bits, uint8_t using2Lines, uint8_t using5x10Font)
 
 void SendByte(uint8_t byte)
 {
-	uint16_t instruction = 0b1000000000;
-	instruction |= byte;
-	SendInstruction(instruction);
-
 	/*
-	  This function is writing data to CGRAM or DDRAM. This internally updates the RAM address counter.
-	  The update happens tADD us after the busy flag turns off. Wait for the busy flag to turn off and
-	  wait for tADD us so that address counter becomes valid for future instructions.
+	  This writes data to CGRAM or DDRAM, which moves the address counter. The counter is updated tADD after the busy
+	  flag turns off. Nothing needs to wait for that here: the next instruction waits for the busy flag anyway, and
+	  the functions that read the address counter wait for tADD themselves.
 	*/
-	while (IsBusy()) {}
-	uint32_t tADD = 4;
-	DWT_delay_us(tADD);
+	SendInstruction(0b1000000000 | byte);
+}
+
+void SendBytes(const uint8_t* bytes, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		SendInstruction(0b1000000000 | bytes[i]);
+	}
 }
 
 void WriteCharacter(uint8_t character)
@@ -307,12 +1255,92 @@ void WriteCharacter(uint8_t character)
 
 void WriteString(const char* text)
 {
-	size_t len = strlen(text);
-	for (size_t i = 0; i < len; i++)
+	SendBytes((const uint8_t*)text, strlen(text));
+}
+
+void WriteStringAt(uint8_t line, uint8_t position, const char* text, size_t len)
+{
+	MoveCursor(line, position);
+	SendBytes((const uint8_t*)text, len);
+}
+
+#if LCD_DISPLAY_COUNT >= 2
+//Sends streams[n] to display n + 1, for every n below streamCount. Every instruction goes to the display that is
+//expected to be ready first, so the execution time of one display is spent writing to the others instead of waiting.
+static void SendInterleaved(const uint16_t* const* streams, const size_t* counts, uint8_t streamCount)
+{
+	uint8_t displays = requestedDisplays;
+#if LCD_ASYNC
+	if (LCD_Async_IsActive())
+	{
+		//The queue sends one instruction at a time anyway, the streams go one after the other.
+		for (uint8_t display = 0; display < streamCount; display++)
+		{
+			LCD_SelectDisplays(1 << display);
+			for (size_t i = 0; i < counts[display]; i++)
+			{
+				SendInstruction(streams[display][i]);
+			}
+		}
+		LCD_SelectDisplays(displays);
+		return;
+	}
+#endif
+
+	size_t sent[LCD_DISPLAY_COUNT] = { 0 };
+	while (1)
+	{
+		uint32_t now = LCD_Now();
+		uint8_t next = streamCount;
+		uint32_t nextRemaining = UINT32_MAX;
+		for (uint8_t display = 0; display < streamCount; display++)
+		{
+			if (sent[display] < counts[display])
+			{
+				uint32_t remaining = DisplayRemainingCycles(display, now);
+				if (remaining < nextRemaining)
+				{
+					next = display;
+					nextRemaining = remaining;
+				}
+			}
+		}
+		if (next == streamCount)
+		{
+			break;
+		}
+		uint16_t instruction = streams[next][sent[next]++];
+		LCD_TrackInstruction(1 << next, instruction);
+		LCD_ApplyDisplaySelection(1 << next);
+		LCD_PrepareWrite();
+		LCD_WriteBus(instruction);
+	}
+#if !LCD_PIPELINED
+	LCD_ApplyDisplaySelection((1 << streamCount) - 1);
+	WaitUntilReady();
+#endif
+	LCD_ApplyDisplaySelection(displays);
+}
+
+void WriteScreen40x4(const char* text)
+{
+	//Each controller gets a DDRAM address set and its 80 characters. In 2-line mode the address counter goes from the
+	//end of line 1 (0x27) to the start of line 2 (0x40) by itself.
+	uint16_t controllerStreams[2][1 + 2 * 40];
+	for (uint8_t controller = 0; controller < 2; controller++)
 	{
-		WriteCharacter(text[i]);
+		uint16_t* stream = controllerStreams[controller];
+		stream[0] = 0b0010000000 | FIRST_LINE_START_ADDRESS_IN_DDRAM;
+		for (size_t i = 0; i < 2 * 40; i++)
+		{
+			stream[1 + i] = 0b1000000000 | (uint8_t)text[controller * 2 * 40 + i];
+		}
 	}
+	const uint16_t* streams[2] = { controllerStreams[0], controllerStreams[1] };
+	const size_t counts[2] = { arr_size(controllerStreams[0]), arr_size(controllerStreams[1]) };
+	SendInterleaved(streams, counts, 2);
 }
+#endif
 
 void SetCGRAMAddress(uint8_t address)
 {
@@ -330,40 +1358,216 @@ void SetDDRAMAddress(uint8_t address)
 	SendInstruction(instruction);
 }
 
-uint8_t IsBusy()
+//Reads the busy flag of the given display, or in timed mode checks whether its pending instruction's execution time
+//has passed.
+static uint8_t ChipBusy(uint8_t display)
 {
-	//Notify the chip we want to read the busy flag
-	HAL_GPIO_WritePin(Pin_RS_GPIO_Port, Pin_RS_Pin, GPIO_PIN_RESET);
-	HAL_GPIO_WritePin(Pin_RW_GPIO_Port, Pin_RW_Pin, GPIO_PIN_SET);
-	uint8_t data = ReadLCDMemory_Internal();
+	if (!useBusyFlag)
+	{
+		const PendingInstruction* p = &pending[display];
+		return (p->instructionClass < LCD_INSTRUCTION_CLASS_COUNT) && ((LCD_Now() - p->issuedAt) < p->cycles);
+	}
+#if LCD_WRITE_ONLY
+	return 0; //Unreachable, useBusyFlag is always 0
+#else
+	uint8_t data = ReadLCDMemory_Internal(READ_BUSY_FLAG, display);
 	return (data >> 7); //highest bit is the busy flag
+#endif
 }
 
-uint8_t ReadAddressCounter()
+//Returns whether any of the selected displays is busy.
+static uint8_t SelectedBusy(void)
+{
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if ((selectedDisplays & (1 << display)) && ChipBusy(display))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint8_t LCD_PollReady(void)
+{
+#if LCD_BURST
+	if (LCD_Burst_IsBusy())
+	{
+		return 0;
+	}
+#endif
+#if LCD_TRACE
+	LCD_Trace_Wait(0, useBusyFlag, 0);
+#endif
+	return !SelectedBusy();
+}
+
+uint8_t LCD_CheckBusyTimeout(void)
+{
+#if LCD_WRITE_ONLY
+	return 0; //Timed mode can't time out
+#else
+	if (!useBusyFlag)
+	{
+		return 0;
+	}
+	uint32_t now = LCD_Now();
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		const PendingInstruction* p = &pending[display];
+		if ((selectedDisplays & (1 << display)) && (now - p->issuedAt) > BusyTimeoutCycles(p))
+		{
+			BusyTimedOut();
+#if LCD_TRACE
+			LCD_Trace_Wait(0, 0, 1);
+#endif
+			return 1;
+		}
+	}
+	return 0;
+#endif
+}
+
+uint8_t LCD_DisplayReady(uint8_t display)
 {
-	//Notify the chip we want to read the address counter
-	HAL_GPIO_WritePin(Pin_RS_GPIO_Port, Pin_RS_Pin, GPIO_PIN_RESET);
-	HAL_GPIO_WritePin(Pin_RW_GPIO_Port, Pin_RW_Pin, GPIO_PIN_SET);
+#if LCD_BURST
+	if (LCD_Burst_IsBusy())
+	{
+		return 0; //Every display shares the bus the burst is on
+	}
+#endif
+	PendingInstruction* p = &pending[display];
+	if (p->instructionClass >= LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		return 1;
+	}
+	uint32_t now = LCD_Now();
+	if (DisplayRemainingCycles(display, now) > 0)
+	{
+		return 0; //Expected to be busy, the bus is left alone
+	}
+#if !LCD_WRITE_ONLY
+	if (useBusyFlag)
+	{
+		busyStats.polls++;
+#if LCD_TRACE
+		LCD_Trace_Wait(0, 1, 0);
+#endif
+		if (ChipBusy(display))
+		{
+			if ((now - p->issuedAt) <= BusyTimeoutCycles(p))
+			{
+				return 0;
+			}
+			BusyTimedOut();
+#if LCD_TRACE
+			LCD_Trace_Wait(0, 0, 1);
+#endif
+		}
+	}
+#endif
+	busyStats.overlappedCycles += ExpectedBusyCycles(p);
+	p->instructionClass = LCD_INSTRUCTION_CLASS_COUNT;
+	return 1;
+}
 
+void LCD_WriteDisplay(uint8_t display, uint16_t instruction)
+{
+#if !LCD_WRITE_ONLY
+	if (recoveryPending && !recovering)
+	{
+		Recover();
+	}
+#endif
+	uint8_t displays = selectedDisplays;
+	uint16_t enablePins = selectedEnablePins;
+	selectedDisplays = 1 << display;
+	selectedEnablePins = LCD_ENABLE_PINS[display];
+	LCD_TrackInstruction(1 << display, instruction);
+	SetDataBusDirection(BUS_DIRECTION_OUTPUT);
+	LCD_WriteBus(instruction);
+	selectedDisplays = displays;
+	selectedEnablePins = enablePins;
+}
+
+uint32_t LCD_RemainingBusyCycles(void)
+{
+	uint32_t remaining = 0;
+	uint32_t now = LCD_Now();
+	for (uint8_t display = 0; display < LCD_DISPLAY_COUNT; display++)
+	{
+		if (selectedDisplays & (1 << display))
+		{
+			uint32_t displayRemaining = DisplayRemainingCycles(display, now);
+			if (displayRemaining > remaining)
+			{
+				remaining = displayRemaining;
+			}
+		}
+	}
+	return remaining;
+}
+
+void LCD_SetDataBusOutput(void)
+{
+	SetDataBusDirection(BUS_DIRECTION_OUTPUT);
+}
+
+uint8_t IsBusy()
+{
+#if LCD_ASYNC
+	//The bus belongs to the timer interrupt while the queue is running
+	if (LCD_Async_IsActive())
+	{
+		return !LCD_Async_IsIdle();
+	}
+#endif
+#if LCD_BURST
+	if (LCD_Burst_IsBusy())
+	{
+		return 1;
+	}
+#endif
+	return SelectedBusy();
+}
+
+#if !LCD_WRITE_ONLY
+uint8_t ReadAddressCounter()
+{
+#if LCD_ASYNC
+	LCD_Async_Flush(); //Everything queued before the read has to reach the chip first
+#endif
 	//Wait until the busy flag turns off
-	while (IsBusy()) { }
-	uint32_t tADD = 4; //Address counter becomes valid tADD us after the busy flag turns off
-	DWT_delay_us(tADD);
+	WaitUntilReady();
+	LCD_DelayCycles(lcdTiming.tADD); //Address counter becomes valid tADD after the busy flag turns off
 
-	uint8_t data = ReadLCDMemory_Internal();
-	return data & 0x7F; //All bits except the highest one make up the address
+	//RS=0, RW=1, the busy flag comes along in the highest bit
+	uint8_t display = __builtin_ctz(selectedDisplays);
+	uint8_t address = ReadLCDMemory_Internal(READ_ADDRESS_COUNTER, display) & 0x7F; //All bits except the busy flag
+	//The chip's value is the truth, the tracked one follows it if it knows which RAM the counter points into
+	ControllerState* state = &controllerState[display];
+	if (state->address != 0)
+	{
+		state->address = (state->address & 0xC0) | address;
+	}
+	return address;
 }
 
 uint8_t ReadByte()
 {
-	//Notify the chip we want to read the RAM
-	HAL_GPIO_WritePin(Pin_RS_GPIO_Port, Pin_RS_Pin, GPIO_PIN_SET);
-	HAL_GPIO_WritePin(Pin_RW_GPIO_Port, Pin_RW_Pin, GPIO_PIN_SET);
-
+#if LCD_ASYNC
+	LCD_Async_Flush(); //Everything queued before the read has to reach the chip first
+#endif
 	//Wait until the busy flag turns off
-	while (IsBusy()) { }
-	uint32_t tADD = 4; //Address counter becomes valid tADD us after the busy flag turns off
-	DWT_delay_us(tADD);
+	WaitUntilReady();
+	LCD_DelayCycles(lcdTiming.tADD); //Address counter becomes valid tADD after the busy flag turns off
 
-	return ReadLCDMemory_Internal();
+	//RS=1, RW=1. This has to come after the busy flag polls, which drive RS low.
+	uint8_t display = __builtin_ctz(selectedDisplays);
+	uint8_t data = ReadLCDMemory_Internal(READ_RAM, display);
+	//Reading RAM moves the address counter, which keeps the chip busy as well
+	MarkDisplayIssued(display, 0b1100000000, LCD_Now());
+	TrackInstruction(&controllerState[display], 0b1100000000);
+	return data;
 }
+#endif
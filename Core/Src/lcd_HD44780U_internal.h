@@ -0,0 +1,121 @@
+/*
+ * lcd_HD44780U_internal.h
+ *
+ *	Driver internals shared between the lcd_*.c files. Application code should only include lcd_HD44780U.h.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef SRC_LCD_HD44780U_INTERNAL_H_
+#define SRC_LCD_HD44780U_INTERNAL_H_
+
+#include <stdint.h>
+#include <lcd_HD44780U.h>
+#include "main.h"
+
+//HD44780U bus timings converted to CPU cycles. Filled in once by Init16x2LCD from the core clock.
+typedef struct
+{
+	uint32_t coreClockHz;
+	uint32_t cyclesPerMicrosecond;
+	uint32_t tAS;
+	uint32_t PWeh;
+	uint32_t tAH;
+	uint32_t tDDR;
+	uint32_t tcycE;
+	uint32_t tADD;
+} LCD_Timing;
+
+extern LCD_Timing lcdTiming;
+
+//Converts a duration to CPU cycles, rounding up.
+uint32_t LCD_NanosecondsToCycles(uint32_t ns);
+
+static inline uint32_t LCD_Now(void)
+{
+	return DWT->CYCCNT;
+}
+
+//Busy waits until the given number of cycles have passed since the cycle stamp since.
+static inline void LCD_WaitSince(uint32_t since, uint32_t cycles)
+{
+	while ((DWT->CYCCNT - since) < cycles) { }
+}
+
+static inline void LCD_DelayCycles(uint32_t cycles)
+{
+	LCD_WaitSince(DWT->CYCCNT, cycles);
+}
+
+//Waits until the chip is ready for the next instruction and turns the data bus into an output.
+void LCD_PrepareWrite(void);
+
+//Puts the given 10-bit instruction on the bus and strobes EN. Does not check the busy flag and does not change the
+//direction of the data bus, the caller is responsible for both.
+void LCD_WriteBus(uint16_t instruction);
+
+//Remembers that the chip started executing the given instruction now. Called after every strobe, by LCD_WriteBus
+//and by anything else that puts instructions on the bus.
+void LCD_MarkIssued(uint16_t instruction);
+
+//How long the given instruction class keeps the chip busy according to the execution time table, in CPU cycles.
+uint32_t LCD_ExecutionCycles(LCD_InstructionClass instructionClass);
+
+//How long the given instruction class is expected to keep the chip busy, in CPU cycles: the busy duration estimate
+//while the busy flag is used (LCD_BUSY_PREDICTOR), the execution time table otherwise. For cost estimates.
+uint32_t LCD_ExpectedCycles(LCD_InstructionClass instructionClass);
+
+//Number of instructions LCD_STATE_CACHE has skipped (elided in LCD_BusyStats), to tell whether a given one was sent.
+uint32_t LCD_ElidedInstructions(void);
+
+//DDRAM column that position 1 of MoveCursor and GetCursorPosition is in (see BeginHiddenPage).
+uint8_t LCD_GetColumnOrigin(void);
+
+//Gets the display shift of the selected displays (positions to the left, modulo 40) from the tracked controller
+//state. Returns 0 if it isn't known or differs between them.
+uint8_t LCD_GetDisplayShift(uint8_t* shift);
+
+//Makes the given display (0 based) use another execution time table, in CPU cycles. NULL goes back to the driver's
+//table. The table has to stay valid while it is in use.
+void LCD_SetDisplayExecutionCycles(uint8_t display, const uint32_t* cycles);
+
+//Non-blocking check of whether the chip can accept the next instruction. Reads the busy flag once, or compares the
+//elapsed time against the execution time in timed mode.
+uint8_t LCD_PollReady(void);
+
+//For callers that poll LCD_PollReady themselves: returns 1 once the pending instruction is past its busy timeout
+//(LCD_BUSY_TIMEOUT_FACTOR). The timeout has been reported and the driver is in timed mode by then, the init sequence
+//is run again on the next call from thread mode.
+uint8_t LCD_CheckBusyTimeout(void);
+
+//Cycles left until the pending instruction is expected to finish (0 if it should be done already). Uses the busy
+//duration estimate when the predictor is enabled, the execution time table otherwise.
+uint32_t LCD_RemainingBusyCycles(void);
+
+//Non-blocking check of whether the given display (0 based) can accept the next instruction. Doesn't touch the bus
+//while the pending instruction is expected to run, and reads the busy flag once after that. Once it returns 1, the
+//display is ready until the next write to it.
+uint8_t LCD_DisplayReady(uint8_t display);
+
+//Strobes the instruction into the given display only, whatever is selected. The display has to be ready (see
+//LCD_DisplayReady).
+void LCD_WriteDisplay(uint8_t display, uint16_t instruction);
+
+//Updates the driver's copy of the controller state of the given displays (see LCD_STATE_CACHE) with an instruction
+//that is sent without SendInstruction.
+void LCD_TrackInstruction(uint8_t displays, uint16_t instruction);
+
+//Makes the following bus accesses go to the given displays (bit n - 1 is display n) right away, without going through
+//the LCD_ASYNC queue.
+void LCD_ApplyDisplaySelection(uint8_t displays);
+
+//E lines of the displays currently selected.
+uint16_t LCD_SelectedEnablePins(void);
+
+//Queue entries with this bit set aren't instructions but a display selection (LCD_SelectDisplays) in the lower byte.
+#define LCD_ASYNC_SELECT_DISPLAYS	(1 << 15)
+
+//Turns the data bus into an output, without waiting for the chip.
+void LCD_SetDataBusOutput(void);
+
+#endif /* SRC_LCD_HD44780U_INTERNAL_H_ */
@@ -0,0 +1,52 @@
+/*
+ * lcd_HD44780U_pinmap.c
+ *
+ *	Byte <-> GPIO register lookup tables for the pin map in lcd_HD44780U_pinmap.h. The tables are generated by the
+ *	preprocessor from the Pin_* macros and placed in flash, nothing is computed at runtime. Tables that the pin map
+ *	doesn't need (e.g. the gather tables when D0-D7 are contiguous) are removed by the linker.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include "lcd_HD44780U_pinmap.h"
+
+//Calls M(n) for n = base ... base + 4^k - 1, separated by commas.
+#define LCD_REPEAT_4(M, base)	M((base) + 0), M((base) + 1), M((base) + 2), M((base) + 3)
+#define LCD_REPEAT_16(M, base)	LCD_REPEAT_4(M, (base) + 0),  LCD_REPEAT_4(M, (base) + 4), \
+								LCD_REPEAT_4(M, (base) + 8),  LCD_REPEAT_4(M, (base) + 12)
+#define LCD_REPEAT_64(M, base)	LCD_REPEAT_16(M, (base) + 0),  LCD_REPEAT_16(M, (base) + 16), \
+								LCD_REPEAT_16(M, (base) + 32), LCD_REPEAT_16(M, (base) + 48)
+#define LCD_REPEAT_256(M)		LCD_REPEAT_64(M, 0),   LCD_REPEAT_64(M, 64), \
+								LCD_REPEAT_64(M, 128), LCD_REPEAT_64(M, 192)
+
+//Pin mask of the data lines of port P that are 1 in the given byte.
+#define SCATTER(byte, P)	((((byte) & 0x01) ? LCD_D0_##P : 0) | (((byte) & 0x02) ? LCD_D1_##P : 0) | \
+							 (((byte) & 0x04) ? LCD_D2_##P : 0) | (((byte) & 0x08) ? LCD_D3_##P : 0) | \
+							 (((byte) & 0x10) ? LCD_D4_##P : 0) | (((byte) & 0x20) ? LCD_D5_##P : 0) | \
+							 (((byte) & 0x40) ? LCD_D6_##P : 0) | (((byte) & 0x80) ? LCD_D7_##P : 0))
+//BSRR word: data lines that are 1 go to the set half, the other data lines of the port to the reset half.
+#define BSRR_ENTRY(byte, P)	((uint32_t)SCATTER(byte, P) | BSRR_RESET(LCD_DATA_PINS_##P & ~SCATTER(byte, P)))
+#define BSRR_ENTRY_A(byte)	BSRR_ENTRY(byte, A)
+#define BSRR_ENTRY_B(byte)	BSRR_ENTRY(byte, B)
+
+//Data lines of port P that are set in 8 bits of an IDR value. shift is 0 for IDR bits 0-7 and 8 for bits 8-15.
+#define GATHER(bits, shift, P)	(((((bits) << (shift)) & LCD_D0_##P) ? 0x01 : 0) | \
+								 ((((bits) << (shift)) & LCD_D1_##P) ? 0x02 : 0) | \
+								 ((((bits) << (shift)) & LCD_D2_##P) ? 0x04 : 0) | \
+								 ((((bits) << (shift)) & LCD_D3_##P) ? 0x08 : 0) | \
+								 ((((bits) << (shift)) & LCD_D4_##P) ? 0x10 : 0) | \
+								 ((((bits) << (shift)) & LCD_D5_##P) ? 0x20 : 0) | \
+								 ((((bits) << (shift)) & LCD_D6_##P) ? 0x40 : 0) | \
+								 ((((bits) << (shift)) & LCD_D7_##P) ? 0x80 : 0))
+#define GATHER_A_LOW(bits)		GATHER(bits, 0, A)
+#define GATHER_A_HIGH(bits)		GATHER(bits, 8, A)
+#define GATHER_B_LOW(bits)		GATHER(bits, 0, B)
+#define GATHER_B_HIGH(bits)		GATHER(bits, 8, B)
+
+const uint32_t LCD_DATA_BSRR_A[256] = { LCD_REPEAT_256(BSRR_ENTRY_A) };
+const uint32_t LCD_DATA_BSRR_B[256] = { LCD_REPEAT_256(BSRR_ENTRY_B) };
+
+const uint8_t LCD_GATHER_A_LOW[256] = { LCD_REPEAT_256(GATHER_A_LOW) };
+const uint8_t LCD_GATHER_A_HIGH[256] = { LCD_REPEAT_256(GATHER_A_HIGH) };
+const uint8_t LCD_GATHER_B_LOW[256] = { LCD_REPEAT_256(GATHER_B_LOW) };
+const uint8_t LCD_GATHER_B_HIGH[256] = { LCD_REPEAT_256(GATHER_B_HIGH) };
@@ -0,0 +1,267 @@
+/*
+ * lcd_HD44780U_pinmap.h
+ *
+ *	Register level view of the LCD pins defined in main.h: which ports and pins the bus is on and the BSRR/IDR/MODER
+ *	values derived from them. Everything here is computed at compile time from the Pin_* macros, so moving the LCD
+ *	to other pins only needs main.h (i.e. the .ioc file) to change.
+ *
+ *	Supported pin maps:
+ *	- D0-D7 on any pins of at most two ports (data port A is the port of D0, data port B the other one, if any)
+ *	- RS, RW and EN on one port, which may also be one of the data ports
+ *	- with LCD_DISPLAY_COUNT > 1, the E line of display n (n >= 2) is Pin_ENn, also on the control port
+ *	Anything else fails the build with a static assert.
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#ifndef SRC_LCD_HD44780U_PINMAP_H_
+#define SRC_LCD_HD44780U_PINMAP_H_
+
+#include <stdint.h>
+#include "lcd_HD44780U_config.h"
+#include "main.h"
+
+//Position (0-15) of a single GPIO_PIN_x mask. This is a constant expression so it can be used in static asserts
+//and initializers.
+#define PIN_POSITION(pin)	((pin) == GPIO_PIN_0  ? 0  : (pin) == GPIO_PIN_1  ? 1  : (pin) == GPIO_PIN_2  ? 2  : \
+							 (pin) == GPIO_PIN_3  ? 3  : (pin) == GPIO_PIN_4  ? 4  : (pin) == GPIO_PIN_5  ? 5  : \
+							 (pin) == GPIO_PIN_6  ? 6  : (pin) == GPIO_PIN_7  ? 7  : (pin) == GPIO_PIN_8  ? 8  : \
+							 (pin) == GPIO_PIN_9  ? 9  : (pin) == GPIO_PIN_10 ? 10 : (pin) == GPIO_PIN_11 ? 11 : \
+							 (pin) == GPIO_PIN_12 ? 12 : (pin) == GPIO_PIN_13 ? 13 : (pin) == GPIO_PIN_14 ? 14 : 15)
+
+//Writing a pin mask to the upper half of BSRR resets those pins, writing it to the lower half sets them.
+#define BSRR_RESET(pins)	((uint32_t)(pins) << 16)
+//Port pointers are casts of constant addresses, GCC folds their comparison at compile time.
+#define SAME_PORT(a, b)		((uintptr_t)(a) == (uintptr_t)(b))
+
+#if LCD_WRITE_ONLY
+//RW is tied low on the board, the pin is not driven (and doesn't need to exist in main.h).
+#define LCD_RW_PIN			0
+_Static_assert(SAME_PORT(Pin_RS_GPIO_Port, Pin_EN_GPIO_Port), "RS and EN must be on the same port");
+#else
+#define LCD_RW_PIN			Pin_RW_Pin
+_Static_assert(SAME_PORT(Pin_RS_GPIO_Port, Pin_RW_GPIO_Port) && SAME_PORT(Pin_RS_GPIO_Port, Pin_EN_GPIO_Port),
+			   "RS, RW and EN must be on the same port");
+#endif
+
+#define LCD_CONTROL_PORT	Pin_RS_GPIO_Port
+
+_Static_assert(LCD_DISPLAY_COUNT >= 1 && LCD_DISPLAY_COUNT <= 8, "LCD_DISPLAY_COUNT must be 1 to 8");
+
+//E lines of the displays sharing the bus. Display 1 uses Pin_EN, display n uses Pin_ENn.
+#if LCD_DISPLAY_COUNT >= 2
+#define LCD_EN2_PIN			Pin_EN2_Pin
+_Static_assert(SAME_PORT(Pin_EN2_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN2 must be on the control port");
+#else
+#define LCD_EN2_PIN			0
+#endif
+#if LCD_DISPLAY_COUNT >= 3
+#define LCD_EN3_PIN			Pin_EN3_Pin
+_Static_assert(SAME_PORT(Pin_EN3_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN3 must be on the control port");
+#else
+#define LCD_EN3_PIN			0
+#endif
+#if LCD_DISPLAY_COUNT >= 4
+#define LCD_EN4_PIN			Pin_EN4_Pin
+_Static_assert(SAME_PORT(Pin_EN4_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN4 must be on the control port");
+#else
+#define LCD_EN4_PIN			0
+#endif
+#if LCD_DISPLAY_COUNT >= 5
+#define LCD_EN5_PIN			Pin_EN5_Pin
+_Static_assert(SAME_PORT(Pin_EN5_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN5 must be on the control port");
+#else
+#define LCD_EN5_PIN			0
+#endif
+#if LCD_DISPLAY_COUNT >= 6
+#define LCD_EN6_PIN			Pin_EN6_Pin
+_Static_assert(SAME_PORT(Pin_EN6_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN6 must be on the control port");
+#else
+#define LCD_EN6_PIN			0
+#endif
+#if LCD_DISPLAY_COUNT >= 7
+#define LCD_EN7_PIN			Pin_EN7_Pin
+_Static_assert(SAME_PORT(Pin_EN7_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN7 must be on the control port");
+#else
+#define LCD_EN7_PIN			0
+#endif
+#if LCD_DISPLAY_COUNT >= 8
+#define LCD_EN8_PIN			Pin_EN8_Pin
+_Static_assert(SAME_PORT(Pin_EN8_GPIO_Port, LCD_CONTROL_PORT), "Pin_EN8 must be on the control port");
+#else
+#define LCD_EN8_PIN			0
+#endif
+
+#define LCD_ALL_ENABLE_PINS	(Pin_EN_Pin | LCD_EN2_PIN | LCD_EN3_PIN | LCD_EN4_PIN | \
+							 LCD_EN5_PIN | LCD_EN6_PIN | LCD_EN7_PIN | LCD_EN8_PIN)
+#define LCD_CONTROL_PINS	(Pin_RS_Pin | LCD_RW_PIN | LCD_ALL_ENABLE_PINS)
+
+//Indexed by display number - 1.
+static const uint16_t LCD_ENABLE_PINS[8] =
+{
+	Pin_EN_Pin, LCD_EN2_PIN, LCD_EN3_PIN, LCD_EN4_PIN, LCD_EN5_PIN, LCD_EN6_PIN, LCD_EN7_PIN, LCD_EN8_PIN,
+};
+
+_Static_assert(__builtin_popcount(LCD_CONTROL_PINS) == 2 + !LCD_WRITE_ONLY + (LCD_DISPLAY_COUNT - 1),
+			   "RS, RW and the E lines must all be on different pins");
+
+//Data port A is the port of D0. Data port B is the port of the first data line that isn't on port A, or port A
+//again if all of them are.
+#define LCD_DATA_PORT_A		Pin_D0_GPIO_Port
+#define LCD_DATA_PORT_B		(!SAME_PORT(Pin_D1_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D1_GPIO_Port : \
+							 !SAME_PORT(Pin_D2_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D2_GPIO_Port : \
+							 !SAME_PORT(Pin_D3_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D3_GPIO_Port : \
+							 !SAME_PORT(Pin_D4_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D4_GPIO_Port : \
+							 !SAME_PORT(Pin_D5_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D5_GPIO_Port : \
+							 !SAME_PORT(Pin_D6_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D6_GPIO_Port : \
+							 Pin_D7_GPIO_Port)
+//Kept for the code that only supports a single data port
+#define LCD_DATA_PORT		LCD_DATA_PORT_A
+
+//Pin mask of each data line on data port A and B (0 if the line is on the other port).
+enum
+{
+	LCD_D0_A = SAME_PORT(Pin_D0_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D0_Pin : 0,
+	LCD_D1_A = SAME_PORT(Pin_D1_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D1_Pin : 0,
+	LCD_D2_A = SAME_PORT(Pin_D2_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D2_Pin : 0,
+	LCD_D3_A = SAME_PORT(Pin_D3_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D3_Pin : 0,
+	LCD_D4_A = SAME_PORT(Pin_D4_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D4_Pin : 0,
+	LCD_D5_A = SAME_PORT(Pin_D5_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D5_Pin : 0,
+	LCD_D6_A = SAME_PORT(Pin_D6_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D6_Pin : 0,
+	LCD_D7_A = SAME_PORT(Pin_D7_GPIO_Port, LCD_DATA_PORT_A) ? Pin_D7_Pin : 0,
+	LCD_D0_B = 0, //D0 defines port A
+	LCD_D1_B = LCD_D1_A ? 0 : Pin_D1_Pin,
+	LCD_D2_B = LCD_D2_A ? 0 : Pin_D2_Pin,
+	LCD_D3_B = LCD_D3_A ? 0 : Pin_D3_Pin,
+	LCD_D4_B = LCD_D4_A ? 0 : Pin_D4_Pin,
+	LCD_D5_B = LCD_D5_A ? 0 : Pin_D5_Pin,
+	LCD_D6_B = LCD_D6_A ? 0 : Pin_D6_Pin,
+	LCD_D7_B = LCD_D7_A ? 0 : Pin_D7_Pin,
+};
+
+#define LCD_DATA_PINS_A		(LCD_D0_A | LCD_D1_A | LCD_D2_A | LCD_D3_A | LCD_D4_A | LCD_D5_A | LCD_D6_A | LCD_D7_A)
+#define LCD_DATA_PINS_B		(LCD_D0_B | LCD_D1_B | LCD_D2_B | LCD_D3_B | LCD_D4_B | LCD_D5_B | LCD_D6_B | LCD_D7_B)
+#define LCD_DATA_USES_PORT_B		(LCD_DATA_PINS_B != 0)
+#define LCD_CONTROL_ON_DATA_PORT_A	SAME_PORT(LCD_CONTROL_PORT, LCD_DATA_PORT_A)
+#define LCD_CONTROL_ON_DATA_PORT_B	(LCD_DATA_USES_PORT_B && SAME_PORT(LCD_CONTROL_PORT, LCD_DATA_PORT_B))
+
+//When D0-D7 are D0-first consecutive pins of one port, a byte can be read back with a shift instead of a table.
+#define LCD_DATA_SHIFT		PIN_POSITION(Pin_D0_Pin)
+#define LCD_DATA_CONTIGUOUS	(!LCD_DATA_USES_PORT_B && Pin_D1_Pin == (Pin_D0_Pin << 1) && Pin_D2_Pin == (Pin_D0_Pin << 2) && \
+							 Pin_D3_Pin == (Pin_D0_Pin << 3) && Pin_D4_Pin == (Pin_D0_Pin << 4) && \
+							 Pin_D5_Pin == (Pin_D0_Pin << 5) && Pin_D6_Pin == (Pin_D0_Pin << 6) && \
+							 Pin_D7_Pin == (Pin_D0_Pin << 7))
+
+_Static_assert((LCD_D1_A || SAME_PORT(Pin_D1_GPIO_Port, LCD_DATA_PORT_B)) &&
+			   (LCD_D2_A || SAME_PORT(Pin_D2_GPIO_Port, LCD_DATA_PORT_B)) &&
+			   (LCD_D3_A || SAME_PORT(Pin_D3_GPIO_Port, LCD_DATA_PORT_B)) &&
+			   (LCD_D4_A || SAME_PORT(Pin_D4_GPIO_Port, LCD_DATA_PORT_B)) &&
+			   (LCD_D5_A || SAME_PORT(Pin_D5_GPIO_Port, LCD_DATA_PORT_B)) &&
+			   (LCD_D6_A || SAME_PORT(Pin_D6_GPIO_Port, LCD_DATA_PORT_B)) &&
+			   (LCD_D7_A || SAME_PORT(Pin_D7_GPIO_Port, LCD_DATA_PORT_B)), "D0-D7 can be spread over 2 ports at most");
+_Static_assert(__builtin_popcount(LCD_DATA_PINS_A) + __builtin_popcount(LCD_DATA_PINS_B) == 8,
+			   "Two data lines are on the same pin");
+_Static_assert(!LCD_CONTROL_ON_DATA_PORT_A || (LCD_DATA_PINS_A & LCD_CONTROL_PINS) == 0,
+			   "A data line is on the same pin as RS, RW or EN");
+_Static_assert(!LCD_CONTROL_ON_DATA_PORT_B || (LCD_DATA_PINS_B & LCD_CONTROL_PINS) == 0,
+			   "A data line is on the same pin as RS, RW or EN");
+
+//MODER has 2 bits per pin: 00 is input, 01 is general purpose output. These spread a pin mask to MODER bits.
+#define MODER_BIT(pins, n)		((((pins) >> (n)) & 0x1u) << (2 * (n)))
+#define MODER_OUTPUT(pins)		(MODER_BIT(pins, 0)  | MODER_BIT(pins, 1)  | MODER_BIT(pins, 2)  | MODER_BIT(pins, 3)  | \
+								 MODER_BIT(pins, 4)  | MODER_BIT(pins, 5)  | MODER_BIT(pins, 6)  | MODER_BIT(pins, 7)  | \
+								 MODER_BIT(pins, 8)  | MODER_BIT(pins, 9)  | MODER_BIT(pins, 10) | MODER_BIT(pins, 11) | \
+								 MODER_BIT(pins, 12) | MODER_BIT(pins, 13) | MODER_BIT(pins, 14) | MODER_BIT(pins, 15))
+#define MODER_MASK(pins)		(MODER_OUTPUT(pins) * 0x3u)
+
+//BSRR words for the control port, indexed by the RS and RW bits of an instruction ((RS << 1) | RW).
+//Every entry also drives all E lines low.
+static const uint32_t LCD_CONTROL_BSRR[4] =
+{
+	BSRR_RESET(Pin_RS_Pin | LCD_RW_PIN | LCD_ALL_ENABLE_PINS),
+	LCD_RW_PIN | BSRR_RESET(Pin_RS_Pin | LCD_ALL_ENABLE_PINS),
+	Pin_RS_Pin | BSRR_RESET(LCD_RW_PIN | LCD_ALL_ENABLE_PINS),
+	Pin_RS_Pin | LCD_RW_PIN | BSRR_RESET(LCD_ALL_ENABLE_PINS),
+};
+
+//Byte -> BSRR word for data port A and B (scatter), generated in lcd_HD44780U_pinmap.c.
+extern const uint32_t LCD_DATA_BSRR_A[256];
+extern const uint32_t LCD_DATA_BSRR_B[256];
+
+//Low and high byte of an IDR value -> the data lines set in it (gather), generated in lcd_HD44780U_pinmap.c.
+extern const uint8_t LCD_GATHER_A_LOW[256];
+extern const uint8_t LCD_GATHER_A_HIGH[256];
+extern const uint8_t LCD_GATHER_B_LOW[256];
+extern const uint8_t LCD_GATHER_B_HIGH[256];
+
+//Returns the data port A BSRR word that puts the given byte on the data lines of port A: ones go to the set half,
+//zeros to the reset half.
+static inline uint32_t LCD_DataToBSRR(uint8_t byte)
+{
+	if (LCD_DATA_CONTIGUOUS)
+	{
+		return ((uint32_t)byte << LCD_DATA_SHIFT) | BSRR_RESET((uint32_t)(uint8_t)~byte << LCD_DATA_SHIFT);
+	}
+	return LCD_DATA_BSRR_A[byte];
+}
+
+//Puts the RS/RW bits (with EN low) and the data byte of the given instruction on the bus. One BSRR store per port
+//involved: control and data share a store when they are on the same port.
+static inline void LCD_PutInstruction(uint16_t instruction)
+{
+	uint32_t control = LCD_CONTROL_BSRR[(instruction >> 8) & 0x3];
+	uint8_t byte = (uint8_t)instruction;
+
+	if (LCD_CONTROL_ON_DATA_PORT_A)
+	{
+		LCD_DATA_PORT_A->BSRR = control | LCD_DataToBSRR(byte);
+	}
+	else
+	{
+		LCD_CONTROL_PORT->BSRR = control;
+		LCD_DATA_PORT_A->BSRR = LCD_DataToBSRR(byte);
+	}
+	if (LCD_DATA_USES_PORT_B)
+	{
+		if (LCD_CONTROL_ON_DATA_PORT_B)
+		{
+			LCD_DATA_PORT_B->BSRR = control | LCD_DATA_BSRR_B[byte];
+		}
+		else
+		{
+			LCD_DATA_PORT_B->BSRR = LCD_DATA_BSRR_B[byte];
+		}
+	}
+}
+
+//Samples the data lines and returns them as a byte. Inverse of LCD_PutInstruction's data part.
+static inline uint8_t LCD_ReadDataBus(void)
+{
+	if (LCD_DATA_CONTIGUOUS)
+	{
+		return (uint8_t)(LCD_DATA_PORT_A->IDR >> LCD_DATA_SHIFT);
+	}
+
+	uint32_t idr = LCD_DATA_PORT_A->IDR;
+	uint8_t value = LCD_GATHER_A_LOW[idr & 0xFF] | LCD_GATHER_A_HIGH[(idr >> 8) & 0xFF];
+	if (LCD_DATA_USES_PORT_B)
+	{
+		idr = LCD_DATA_PORT_B->IDR;
+		value |= LCD_GATHER_B_LOW[idr & 0xFF] | LCD_GATHER_B_HIGH[(idr >> 8) & 0xFF];
+	}
+	return value;
+}
+
+//Switches the data lines between input (output = 0) and output with one masked MODER write per data port.
+static inline void LCD_SetDataBusMode(uint8_t output)
+{
+	uint32_t moder = LCD_DATA_PORT_A->MODER & ~MODER_MASK(LCD_DATA_PINS_A);
+	LCD_DATA_PORT_A->MODER = output ? (moder | MODER_OUTPUT(LCD_DATA_PINS_A)) : moder;
+	if (LCD_DATA_USES_PORT_B)
+	{
+		moder = LCD_DATA_PORT_B->MODER & ~MODER_MASK(LCD_DATA_PINS_B);
+		LCD_DATA_PORT_B->MODER = output ? (moder | MODER_OUTPUT(LCD_DATA_PINS_B)) : moder;
+	}
+}
+
+#endif /* SRC_LCD_HD44780U_PINMAP_H_ */
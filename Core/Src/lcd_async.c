@@ -0,0 +1,187 @@
+/*
+ * lcd_async.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_async.h>
+#include <lcd_burst.h>
+
+#if LCD_ASYNC
+
+#include "lcd_HD44780U_internal.h"
+#include "main.h"
+
+_Static_assert((LCD_ASYNC_QUEUE_SIZE & (LCD_ASYNC_QUEUE_SIZE - 1)) == 0, "LCD_ASYNC_QUEUE_SIZE must be a power of 2");
+
+#define ASYNC_TIMER				TIM7
+#define ASYNC_TIMER_IRQn		TIM7_IRQn
+
+//Time between two busy flag polls while the chip takes longer than expected, in microseconds.
+static const uint32_t POLL_INTERVAL_US = 2;
+
+//Single producer (the application) single consumer (the interrupt) ring buffer. head and tail are free running,
+//the slot is the index modulo the queue size.
+static uint16_t queue[LCD_ASYNC_QUEUE_SIZE];
+static volatile uint32_t head;
+static volatile uint32_t tail;
+
+static volatile uint8_t active;
+//Whether the interrupt is currently scheduled. Once it finds nothing to do, the timer is left stopped and the next
+//enqueue restarts it.
+static volatile uint8_t running;
+//Whether an instruction has been strobed and the chip hasn't been seen ready since.
+static uint8_t inFlight;
+static uint16_t inFlightInstruction;
+static volatile uint32_t completed;
+static LCD_Async_Callback completionCallback;
+
+//Fires the timer interrupt once, the given number of microseconds from now.
+static void ScheduleTick(uint32_t microseconds)
+{
+	if (microseconds == 0)
+	{
+		microseconds = 1;
+	}
+	else if (microseconds > 0xFFFF)
+	{
+		microseconds = 0xFFFF;
+	}
+	ASYNC_TIMER->ARR = microseconds;
+	ASYNC_TIMER->CNT = 0;
+	ASYNC_TIMER->CR1 |= TIM_CR1_CEN; //One pulse mode clears CEN on the update event
+}
+
+void LCD_Async_Init(void)
+{
+	__HAL_RCC_TIM7_CLK_ENABLE();
+
+	//APB1 timers run at twice the bus clock whenever the APB1 prescaler isn't 1.
+	uint32_t timerClock = HAL_RCC_GetPCLK1Freq();
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+	{
+		timerClock *= 2;
+	}
+
+	ASYNC_TIMER->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+	ASYNC_TIMER->PSC = (timerClock / 1000000) - 1; //1 tick = 1 us
+	ASYNC_TIMER->EGR = TIM_EGR_UG; //Load the prescaler, URS keeps this from raising the interrupt
+	ASYNC_TIMER->SR = 0;
+	ASYNC_TIMER->DIER = TIM_DIER_UIE;
+
+	HAL_NVIC_SetPriority(ASYNC_TIMER_IRQn, LCD_ASYNC_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(ASYNC_TIMER_IRQn);
+
+	active = 1;
+}
+
+uint8_t LCD_Async_IsActive(void)
+{
+	return active;
+}
+
+uint32_t LCD_Async_Enqueue(uint16_t instruction)
+{
+	while ((head - tail) >= LCD_ASYNC_QUEUE_SIZE) { } //Full, the interrupt frees slots
+
+	queue[head & (LCD_ASYNC_QUEUE_SIZE - 1)] = instruction;
+	__DMB(); //The slot has to be written before the interrupt can see it
+	head++;
+	uint32_t ticket = head;
+
+	//The interrupt clears running when it finds the queue empty. Checking and setting it with interrupts disabled
+	//makes sure an instruction queued at that moment still gets a tick.
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (!running)
+	{
+		running = 1;
+		NVIC_SetPendingIRQ(ASYNC_TIMER_IRQn);
+	}
+	__set_PRIMASK(primask);
+
+	return ticket;
+}
+
+uint32_t LCD_Async_LastTicket(void)
+{
+	return head;
+}
+
+uint8_t LCD_Async_IsComplete(uint32_t ticket)
+{
+	return (int32_t)(completed - ticket) >= 0;
+}
+
+uint8_t LCD_Async_IsIdle(void)
+{
+	return !running && (head == tail);
+}
+
+void LCD_Async_Flush(void)
+{
+	while (!LCD_Async_IsIdle()) { }
+}
+
+void LCD_Async_SetCallback(LCD_Async_Callback callback)
+{
+	completionCallback = callback;
+}
+
+void LCD_Async_TimerIRQHandler(void)
+{
+	//Also entered through NVIC_SetPendingIRQ, in which case the update flag isn't set.
+	ASYNC_TIMER->SR = ~(uint32_t)TIM_SR_UIF;
+
+	if (inFlight)
+	{
+		if (!LCD_PollReady() && !LCD_CheckBusyTimeout())
+		{
+			ScheduleTick(POLL_INTERVAL_US);
+			return;
+		}
+		//After a timeout the instruction is given up on and the queue goes on in timed mode.
+		inFlight = 0;
+		completed++;
+		if (completionCallback != NULL)
+		{
+			completionCallback(inFlightInstruction);
+		}
+	}
+
+#if LCD_BURST
+	if (LCD_Burst_IsBusy())
+	{
+		ScheduleTick(POLL_INTERVAL_US); //DMA drives the bus, the queue goes on after the burst
+		return;
+	}
+#endif
+
+	//Display selections take effect between instructions. All displays are ready at this point, since every
+	//instruction is waited for before the next one goes out.
+	while (head != tail && (queue[tail & (LCD_ASYNC_QUEUE_SIZE - 1)] & LCD_ASYNC_SELECT_DISPLAYS))
+	{
+		LCD_ApplyDisplaySelection((uint8_t)queue[tail & (LCD_ASYNC_QUEUE_SIZE - 1)]);
+		tail++;
+		completed++;
+	}
+
+	if (head == tail)
+	{
+		running = 0;
+		return;
+	}
+
+	//Setup, strobe and hold all take well below a microsecond, so they are done right here.
+	inFlightInstruction = queue[tail & (LCD_ASYNC_QUEUE_SIZE - 1)];
+	tail++;
+	LCD_SetDataBusOutput();
+	LCD_WriteBus(inFlightInstruction);
+	inFlight = 1;
+
+	//Come back when the chip is expected to be done
+	ScheduleTick(LCD_RemainingBusyCycles() / lcdTiming.cyclesPerMicrosecond + 1);
+}
+
+#endif /* LCD_ASYNC */
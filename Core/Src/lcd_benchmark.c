@@ -0,0 +1,261 @@
+/*
+ * lcd_benchmark.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_benchmark.h>
+
+#if LCD_ENABLE_BENCHMARK
+
+#include <lcd_HD44780U.h>
+#include <lcd_burst.h>
+#include <lcd_framebuffer.h>
+#include "lcd_HD44780U_internal.h"
+#include "main.h"
+#include <string.h>
+
+//Set DDRAM address 0. Harmless to send any number of times.
+static const uint16_t BENCHMARK_INSTRUCTION = 0b0010000000;
+static const char BENCHMARK_LINE[] = "0123456789ABCDEF";
+
+#if LCD_FRAMEBUFFER
+//A typical status screen, and the same screen a second later.
+static const char DASHBOARD_BEFORE[2][17] = { "T 21.4C  H 48%  ", "P 1013hPa  12:04" };
+static const char DASHBOARD_AFTER[2][17] = { "T 21.5C  H 47%  ", "P 1013hPa  12:05" };
+
+//Screen transitions taken from our applications: both lines before and after.
+typedef struct
+{
+	const char* before[2];
+	const char* after[2];
+} Transition;
+
+static const Transition CORPUS[] =
+{
+	{ { "T 21.4C  H 48%", "P 1013hPa  12:04" }, { "T 21.5C  H 47%", "P 1013hPa  12:05" } },	//Sensor dashboard
+	{ { "12:59:59", "Mon 01.06.2026" }, { "13:00:00", "Mon 01.06.2026" } },					//Clock rollover
+	{ { ">Settings", " Display" }, { " Settings", ">Display" } },							//Menu cursor
+	{ { "Temperature 21C", "Humidity 48%" }, { "Network: online", "IP 10.0.0.17" } },		//Page change
+	{ { "Vin 12.34V", "Iout 0.567A" }, { "Vin 12.35V", "Iout 0.568A" } },					//Power monitor
+	{ { "Copying 45%", "[#######       ]" }, { "Copying 52%", "[########      ]" } },		//Progress bar
+	{ { "rx 0123456789abcdef0123456789abcdef0123", "tx fedcba9876543210fedcba9876543210fedc" },
+	  { "Done", "" } },																		//40 column log to result
+};
+
+//Puts the given lines into the framebuffer and commits them.
+static void RenderScreen(const char* const* lines)
+{
+	LCD_Framebuffer_Fill(' ');
+	for (uint8_t line = 1; line <= 2; line++)
+	{
+		LCD_Framebuffer_Write(line, 1, lines[line - 1], strlen(lines[line - 1]));
+	}
+	LCD_Framebuffer_Commit();
+}
+
+//Measures every transition of the corpus with the given flush, start to finish. Returns the cycles, the instructions
+//sent are added to writes.
+static uint32_t MeasureCorpus(uint32_t (*flush)(void), uint32_t* writes)
+{
+	uint32_t total = 0;
+	*writes = 0;
+	for (size_t i = 0; i < arr_size(CORPUS); i++)
+	{
+		RenderScreen(CORPUS[i].before);
+		LCD_Flush();
+		LCD_PrepareWrite();
+
+		uint32_t start = DWT->CYCCNT;
+		RenderScreen(CORPUS[i].after);
+		*writes += flush();
+		LCD_PrepareWrite();
+		total += DWT->CYCCNT - start;
+	}
+	return total;
+}
+#endif
+
+static void ReferenceDelay_us(uint32_t delay)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t requiredCycles = delay * (HAL_RCC_GetHCLKFreq() / 1000000);
+	while ((DWT->CYCCNT - start) < requiredCycles) { }
+}
+
+//The write path the driver used before the BSRR path (including its timing), kept here so both can be measured
+//on the same board.
+static void HALWriteReference(uint16_t instruction)
+{
+	GPIO_TypeDef* ports[] = { Pin_RS_GPIO_Port, Pin_RW_GPIO_Port, Pin_D7_GPIO_Port, Pin_D6_GPIO_Port,
+							  Pin_D5_GPIO_Port, Pin_D4_GPIO_Port, Pin_D3_GPIO_Port, Pin_D2_GPIO_Port,
+							  Pin_D1_GPIO_Port, Pin_D0_GPIO_Port };
+
+	uint16_t pins[] 	  = { Pin_RS_Pin, Pin_RW_Pin, Pin_D7_Pin, Pin_D6_Pin, Pin_D5_Pin,
+			                  Pin_D4_Pin, Pin_D3_Pin, Pin_D2_Pin, Pin_D1_Pin, Pin_D0_Pin };
+	for (size_t i = 0; i < arr_size(pins); i++)
+	{
+		HAL_GPIO_WritePin(ports[i], pins[i], (instruction >> ((arr_size(pins) - 1) - i)) & 0x1);
+	}
+	ReferenceDelay_us(1);
+	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_SET);
+	ReferenceDelay_us(1);
+	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_RESET);
+	for (int i = 0; i < 100; i++)
+	{
+		__NOP();
+	}
+}
+
+//Measures the average cost of one call of the given write function. The LCD is waited on outside of the measured
+//window so only the CPU side of the bus access is counted.
+static uint32_t MeasureWrite(void (*write)(uint16_t))
+{
+	uint32_t total = 0;
+	for (int i = 0; i < LCD_BENCHMARK_ITERATIONS; i++)
+	{
+		LCD_PrepareWrite();
+
+		uint32_t start = DWT->CYCCNT;
+		write(BENCHMARK_INSTRUCTION);
+		total += DWT->CYCCNT - start;
+	}
+	return total / LCD_BENCHMARK_ITERATIONS;
+}
+
+void LCD_Benchmark_Run(LCD_BenchmarkResults* results)
+{
+	results->halWriteCycles = MeasureWrite(HALWriteReference);
+	results->busWriteCycles = MeasureWrite(LCD_WriteBus);
+
+	uint32_t total = 0;
+	for (int i = 0; i < LCD_BENCHMARK_ITERATIONS; i++)
+	{
+		uint32_t start = DWT->CYCCNT;
+		IsBusy();
+		total += DWT->CYCCNT - start;
+	}
+	results->isBusyCycles = total / LCD_BENCHMARK_ITERATIONS;
+
+	//Whole line writes. The chip's execution time is part of these, they show the achievable throughput.
+	LCD_PrepareWrite();
+	uint32_t start = DWT->CYCCNT;
+	MoveCursor(1, 1);
+	for (size_t i = 0; i < strlen(BENCHMARK_LINE); i++)
+	{
+		SendInstruction(0b1000000000 | (uint8_t)BENCHMARK_LINE[i]);
+		LCD_PrepareWrite();
+		LCD_DelayCycles(lcdTiming.tADD);
+	}
+	results->perByteWaitCycles = DWT->CYCCNT - start;
+
+	LCD_PrepareWrite();
+	start = DWT->CYCCNT;
+	WriteStringAt(1, 1, BENCHMARK_LINE, strlen(BENCHMARK_LINE));
+	LCD_PrepareWrite();
+	results->writeStringCycles = DWT->CYCCNT - start;
+
+#if LCD_DISPLAY_COUNT >= 2
+	static char screen[4 * 40];
+	for (size_t i = 0; i < sizeof(screen); i++)
+	{
+		screen[i] = BENCHMARK_LINE[i % strlen(BENCHMARK_LINE)];
+	}
+	uint8_t displays = LCD_GetSelectedDisplays();
+
+	LCD_SelectDisplays(0b11);
+	LCD_PrepareWrite();
+	start = DWT->CYCCNT;
+	for (uint8_t line = 1; line <= 4; line++)
+	{
+		WriteStringAt(line, 1, &screen[(line - 1) * 40], 40);
+	}
+	LCD_SelectDisplays(0b11);
+	LCD_PrepareWrite();
+	results->sequential40x4Cycles = DWT->CYCCNT - start;
+
+	start = DWT->CYCCNT;
+	WriteScreen40x4(screen);
+	LCD_SelectDisplays(0b11);
+	LCD_PrepareWrite();
+	results->screen40x4Cycles = DWT->CYCCNT - start;
+	LCD_SelectDisplays(displays);
+#endif
+
+#if LCD_FRAMEBUFFER
+	//Both lines of the new screen rewritten, as an application without the framebuffer would
+	for (uint8_t line = 1; line <= 2; line++)
+	{
+		WriteStringAt(line, 1, DASHBOARD_BEFORE[line - 1], 16);
+	}
+	LCD_PrepareWrite();
+	start = DWT->CYCCNT;
+	for (uint8_t line = 1; line <= 2; line++)
+	{
+		WriteStringAt(line, 1, DASHBOARD_AFTER[line - 1], 16);
+	}
+	LCD_PrepareWrite();
+	results->dashboardRewriteCycles = DWT->CYCCNT - start;
+
+	//The whole screen is written into the framebuffer, only the changed digits are sent
+	LCD_Framebuffer_Invalidate();
+	for (uint8_t line = 1; line <= 2; line++)
+	{
+		LCD_Framebuffer_Write(line, 1, DASHBOARD_BEFORE[line - 1], 16);
+	}
+	LCD_Framebuffer_Commit();
+	LCD_Flush();
+	LCD_PrepareWrite();
+	start = DWT->CYCCNT;
+	for (uint8_t line = 1; line <= 2; line++)
+	{
+		LCD_Framebuffer_Write(line, 1, DASHBOARD_AFTER[line - 1], 16);
+	}
+	LCD_Framebuffer_Commit();
+	results->dashboardFlushWrites = LCD_Flush();
+	LCD_PrepareWrite();
+	results->dashboardFlushCycles = DWT->CYCCNT - start;
+
+	results->corpusRunsCycles = MeasureCorpus(LCD_FlushRuns, &results->corpusRunsWrites);
+	results->corpusPlannedCycles = MeasureCorpus(LCD_Flush, &results->corpusPlannedWrites);
+
+	//The page change drawn into the hidden columns by the framebuffer and flipped in. The flush must not clear or
+	//return home, that would paint the page onto the visible one.
+	const Transition* page = &CORPUS[3];
+	RenderScreen(page->before);
+	LCD_Flush();
+	for (uint8_t line = 1; line <= 2; line++)
+	{
+		LCD_Framebuffer_Write(line, 21, page->after[line - 1], strlen(page->after[line - 1]));
+	}
+	LCD_Framebuffer_Commit();
+	LCD_PrepareWrite();
+	start = DWT->CYCCNT;
+	BeginHiddenPage();
+	results->pageFlipWrites = LCD_Flush();
+	results->pageFlipIntact = LCD_GetColumnOrigin() == 20;
+	ShowHiddenPage();
+	LCD_PrepareWrite();
+	results->pageFlipCycles = DWT->CYCCNT - start;
+	ReturnHome();
+#endif
+
+#if LCD_BURST
+	uint16_t instructions[1 + sizeof(BENCHMARK_LINE) - 1];
+	instructions[0] = 0b0010000000; //Set DDRAM address 0
+	for (size_t i = 0; i < strlen(BENCHMARK_LINE); i++)
+	{
+		instructions[i + 1] = 0b1000000000 | (uint8_t)BENCHMARK_LINE[i];
+	}
+	LCD_PrepareWrite();
+	start = DWT->CYCCNT;
+	LCD_Burst_Start(instructions, arr_size(instructions));
+	results->burstCpuCycles = DWT->CYCCNT - start;
+	LCD_Burst_Wait();
+	while (IsBusy()) { }
+	results->burstTotalCycles = DWT->CYCCNT - start;
+#endif
+}
+
+#endif /* LCD_ENABLE_BENCHMARK */
@@ -0,0 +1,211 @@
+/*
+ * lcd_burst.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_burst.h>
+
+#if LCD_BURST
+
+#include <lcd_HD44780U.h>
+#include <lcd_async.h>
+#include <lcd_trace.h>
+#include "lcd_HD44780U_internal.h"
+#include "lcd_HD44780U_pinmap.h"
+#include "main.h"
+
+/*
+	Every instruction occupies one or more slots of one timer period each. Within a slot:
+	- update event (start of the slot): DMA2 Stream 1 writes the data word to the data port
+	- CC1: DMA2 Stream 2 writes RS/RW with EN low to the control port
+	- CC2 (tAS later): EN high
+	- CC3 (PWeh later): EN low
+	The remaining slots of an instruction that takes longer than one slot are empty: all their words are 0, which
+	BSRR ignores.
+*/
+#define BURST_TIMER				TIM8
+#define DATA_STREAM				DMA2_Stream1	//TIM8_UP, channel 7
+#define CONTROL_STREAM			DMA2_Stream2	//TIM8_CH1/CH2/CH3, channel 0
+#define DATA_STREAM_CHANNEL		7
+#define CONTROL_STREAM_CHANNEL	0
+
+//The data words are written to a single port by one stream.
+_Static_assert(!LCD_DATA_USES_PORT_B, "Bursts need D0-D7 on one port");
+
+//Extra timer ticks on top of every phase, for DMA request latency.
+static const uint32_t PHASE_MARGIN_TICKS = 2;
+
+static uint32_t dataWords[LCD_BURST_MAX_SLOTS];
+static uint32_t controlWords[LCD_BURST_MAX_SLOTS * 3];
+
+static uint32_t timerClockHz;
+static uint32_t slotCycles; //Slot length in CPU cycles
+static volatile uint8_t busy;
+static uint16_t lastInstruction;
+
+//Converts CPU cycles to timer ticks, rounding up.
+static uint32_t CyclesToTicks(uint32_t cycles)
+{
+	return (uint32_t)(((uint64_t)cycles * timerClockHz + lcdTiming.coreClockHz - 1) / lcdTiming.coreClockHz);
+}
+
+void LCD_Burst_Init(void)
+{
+	__HAL_RCC_TIM8_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
+
+	//APB2 timers run at twice the bus clock whenever the APB2 prescaler isn't 1.
+	timerClockHz = HAL_RCC_GetPCLK2Freq();
+	if ((RCC->CFGR & RCC_CFGR_PPRE2) != RCC_CFGR_PPRE2_DIV1)
+	{
+		timerClockHz *= 2;
+	}
+
+	BURST_TIMER->CR1 = 0;
+	BURST_TIMER->PSC = 0;
+	BURST_TIMER->CCMR1 = 0; //Frozen output compare, only the DMA requests are used
+	BURST_TIMER->CCMR2 = 0;
+	BURST_TIMER->CCR1 = 1;
+	BURST_TIMER->CCR2 = BURST_TIMER->CCR1 + CyclesToTicks(lcdTiming.tAS) + PHASE_MARGIN_TICKS;
+	BURST_TIMER->CCR3 = BURST_TIMER->CCR2 + CyclesToTicks(lcdTiming.PWeh) + PHASE_MARGIN_TICKS;
+	BURST_TIMER->EGR = TIM_EGR_UG;
+	BURST_TIMER->SR = 0;
+
+	HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, LCD_ASYNC_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+}
+
+//Memory to peripheral, 32-bit words, memory increment.
+static void StartStream(DMA_Stream_TypeDef* stream, uint32_t channel, volatile uint32_t* destination,
+						const uint32_t* words, uint32_t count, uint32_t interrupts)
+{
+	stream->CR = 0;
+	while (stream->CR & DMA_SxCR_EN) { }
+	stream->PAR = (uint32_t)destination;
+	stream->M0AR = (uint32_t)words;
+	stream->NDTR = count;
+	stream->FCR = 0; //Direct mode
+	stream->CR = (channel << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+				 DMA_SxCR_MINC | DMA_SxCR_DIR_0 | interrupts;
+	stream->CR |= DMA_SxCR_EN;
+}
+
+//Number of slots the given instruction occupies.
+static size_t InstructionSlots(uint16_t instruction, uint8_t isLast)
+{
+	uint32_t execution = LCD_ExecutionCycles(LCD_ClassifyInstruction(instruction));
+	size_t instructionSlots = (execution + slotCycles - 1) / slotCycles;
+	if (instructionSlots == 0 || isLast)
+	{
+		//The last instruction doesn't need empty slots, LCD_MarkIssued takes over its execution time.
+		instructionSlots = 1;
+	}
+	return instructionSlots;
+}
+
+uint8_t LCD_Burst_Start(const uint16_t* instructions, size_t count)
+{
+	if (busy || count == 0)
+	{
+		return 0;
+	}
+
+	//One slot is the execution time of a data write, the most common instruction of a burst. Read every time so
+	//that changes made with SetInstructionExecutionTime are picked up.
+	slotCycles = LCD_ExecutionCycles(LCD_INSTRUCTION_WRITE_DATA);
+
+	//All selected displays get the burst, like they get every other write
+	uint32_t enablePins = LCD_SelectedEnablePins();
+	size_t slots = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint16_t instruction = instructions[i];
+		if (instruction & (1 << 8)) //RW, reads can't be done by DMA
+		{
+			return 0;
+		}
+		size_t instructionSlots = InstructionSlots(instruction, i == count - 1);
+		if (slots + instructionSlots > LCD_BURST_MAX_SLOTS)
+		{
+			return 0;
+		}
+
+		dataWords[slots] = LCD_DataToBSRR((uint8_t)instruction);
+		controlWords[slots * 3 + 0] = LCD_CONTROL_BSRR[(instruction >> 8) & 0x3];
+		controlWords[slots * 3 + 1] = enablePins;
+		controlWords[slots * 3 + 2] = BSRR_RESET(LCD_ALL_ENABLE_PINS);
+		slots++;
+		for (size_t j = 1; j < instructionSlots; j++, slots++)
+		{
+			dataWords[slots] = 0;
+			controlWords[slots * 3 + 0] = 0;
+			controlWords[slots * 3 + 1] = 0;
+			controlWords[slots * 3 + 2] = 0;
+		}
+	}
+	lastInstruction = instructions[count - 1];
+	for (size_t i = 0; i < count; i++)
+	{
+		LCD_TrackInstruction(LCD_GetSelectedDisplays(), instructions[i]);
+	}
+
+#if LCD_ASYNC
+	LCD_Async_Flush();
+#endif
+	LCD_PrepareWrite();
+	busy = 1;
+
+	DMA2->LIFCR = DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1 |
+				  DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2;
+	StartStream(DATA_STREAM, DATA_STREAM_CHANNEL, &LCD_DATA_PORT->BSRR, dataWords, slots, 0);
+	StartStream(CONTROL_STREAM, CONTROL_STREAM_CHANNEL, &LCD_CONTROL_PORT->BSRR, controlWords, slots * 3,
+				DMA_SxCR_TCIE);
+
+	//Start right before the update event so the first data word goes out before the first CC1.
+	BURST_TIMER->ARR = CyclesToTicks(slotCycles) - 1;
+	BURST_TIMER->SR = 0;
+	BURST_TIMER->CNT = BURST_TIMER->ARR - 1;
+	BURST_TIMER->DIER = TIM_DIER_UDE | TIM_DIER_CC1DE | TIM_DIER_CC2DE | TIM_DIER_CC3DE;
+	BURST_TIMER->CR1 |= TIM_CR1_CEN;
+
+#if LCD_TRACE
+	//The strobes are made by DMA later on, they are recorded with the time the timer will make them at.
+	uint32_t enableRise = LCD_Now() + (uint32_t)(((uint64_t)(BURST_TIMER->CCR2 + 1) * lcdTiming.coreClockHz) /
+												 timerClockHz);
+	for (size_t i = 0; i < count; i++)
+	{
+		LCD_Trace_Access(instructions[i], enableRise, LCD_TRACE_FLAG_BURST);
+		enableRise += InstructionSlots(instructions[i], i == count - 1) * slotCycles;
+	}
+#endif
+	return 1;
+}
+
+uint8_t LCD_Burst_IsBusy(void)
+{
+	return busy;
+}
+
+void LCD_Burst_Wait(void)
+{
+	while (busy) { }
+}
+
+void LCD_Burst_DMAIRQHandler(void)
+{
+	if (DMA2->LISR & DMA_LISR_TCIF2)
+	{
+		DMA2->LIFCR = DMA_LIFCR_CTCIF2;
+		//The last EN falling edge has just gone out
+		BURST_TIMER->CR1 &= ~TIM_CR1_CEN;
+		BURST_TIMER->DIER = 0;
+		DATA_STREAM->CR = 0;
+		LCD_MarkIssued(lastInstruction);
+		busy = 0;
+	}
+	DMA2->LIFCR = DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2 | DMA_LIFCR_CHTIF2;
+}
+
+#endif /* LCD_BURST */
@@ -0,0 +1,533 @@
+/*
+ * lcd_framebuffer.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_framebuffer.h>
+
+#if LCD_FRAMEBUFFER
+
+#include <lcd_HD44780U.h>
+#include "lcd_HD44780U_internal.h"
+#include "main.h"
+#include <string.h>
+
+//DDRAM address of the first character of each line.
+static const uint8_t LINE_START_ADDRESS[LCD_FRAMEBUFFER_LINES] = { 0x00, 0x40 };
+//One dirty bit per character of a line.
+static const uint64_t ALL_COLUMNS = (1ull << LCD_FRAMEBUFFER_COLUMNS) - 1;
+
+typedef char Frame[LCD_FRAMEBUFFER_LINES][LCD_FRAMEBUFFER_COLUMNS];
+
+//The front buffer is the last committed frame, the one LCD_Flush sends. The application renders into the other one.
+//Only LCD_Framebuffer_Commit switches them, with interrupts disabled.
+static Frame buffers[2];
+static volatile uint8_t front;
+//Set by a commit until LCD_Flush has compared the new front buffer with shown.
+static volatile uint8_t committed;
+
+//What the DDRAM holds after everything sent so far. Only LCD_Flush uses it.
+static Frame shown;
+//Bit n of a line is set when column n differs between the front buffer and shown.
+static uint64_t dirty[LCD_FRAMEBUFFER_LINES];
+//Bit n of a line is set when column n of shown can't be trusted (LCD_Framebuffer_Invalidate). These are sent
+//whatever the front buffer holds.
+static uint64_t unknown[LCD_FRAMEBUFFER_LINES];
+//Number of the commit each cell last changed in, and for dirty cells the commit they have been waiting since, so the
+//oldest ones can be sent first.
+static uint32_t changedIn[LCD_FRAMEBUFFER_LINES][LCD_FRAMEBUFFER_COLUMNS];
+static uint32_t dirtySince[LCD_FRAMEBUFFER_LINES][LCD_FRAMEBUFFER_COLUMNS];
+static uint32_t commitNumber;
+
+static inline Frame* Back(void)
+{
+	return &buffers[front ^ 1];
+}
+
+void LCD_Framebuffer_Init(void)
+{
+	memset(buffers, ' ', sizeof(buffers));
+	memset(shown, ' ', sizeof(shown));
+	memset(dirty, 0, sizeof(dirty));
+	memset(unknown, 0, sizeof(unknown));
+	committed = 0;
+}
+
+void LCD_Framebuffer_Write(uint8_t line, uint8_t position, const char* text, size_t len)
+{
+	if (line < 1 || line > LCD_FRAMEBUFFER_LINES || position < 1)
+	{
+		return;
+	}
+	char* cells = (*Back())[line - 1];
+	for (size_t i = 0; i < len && (position - 1 + i) < LCD_FRAMEBUFFER_COLUMNS; i++)
+	{
+		cells[position - 1 + i] = text[i];
+	}
+}
+
+void LCD_Framebuffer_Fill(char character)
+{
+	memset(*Back(), character, sizeof(Frame));
+}
+
+char LCD_Framebuffer_GetChar(uint8_t line, uint8_t position)
+{
+	if (line < 1 || line > LCD_FRAMEBUFFER_LINES || position < 1 || position > LCD_FRAMEBUFFER_COLUMNS)
+	{
+		return 0;
+	}
+	return (*Back())[line - 1][position - 1];
+}
+
+void LCD_Framebuffer_Commit(void)
+{
+	//Both buffers only change in thread mode, they can be compared before the switch
+	commitNumber++;
+	const Frame* back = Back();
+	for (uint8_t line = 0; line < LCD_FRAMEBUFFER_LINES; line++)
+	{
+		for (uint8_t column = 0; column < LCD_FRAMEBUFFER_COLUMNS; column++)
+		{
+			if ((*back)[line][column] != buffers[front][line][column])
+			{
+				changedIn[line][column] = commitNumber;
+			}
+		}
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	front ^= 1;
+	//Rendering goes on from the committed frame, so only what changes needs to be written again
+	memcpy(*Back(), buffers[front], sizeof(Frame));
+	committed = 1;
+	__set_PRIMASK(primask);
+}
+
+void LCD_Framebuffer_Invalidate(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for (uint8_t line = 0; line < LCD_FRAMEBUFFER_LINES; line++)
+	{
+		unknown[line] = ALL_COLUMNS;
+	}
+	committed = 1;
+	__set_PRIMASK(primask);
+}
+
+uint8_t LCD_Framebuffer_IsDirty(void)
+{
+	if (committed)
+	{
+		return 1;
+	}
+	for (uint8_t line = 0; line < LCD_FRAMEBUFFER_LINES; line++)
+	{
+		if (dirty[line] != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//Marks the cells of the front buffer that differ from the DDRAM. Cells that were dirty already keep their age.
+static void Diff(void)
+{
+	const Frame* frame = &buffers[front];
+	for (uint8_t line = 0; line < LCD_FRAMEBUFFER_LINES; line++)
+	{
+		uint64_t bits = unknown[line];
+		for (uint8_t column = 0; column < LCD_FRAMEBUFFER_COLUMNS; column++)
+		{
+			if ((*frame)[line][column] != shown[line][column])
+			{
+				bits |= 1ull << column;
+			}
+			if ((bits & ~dirty[line]) & (1ull << column))
+			{
+				dirtySince[line][column] = changedIn[line][column];
+			}
+		}
+		dirty[line] = bits;
+	}
+}
+
+//Cells are numbered in the order the address counter goes through them in 2-line mode: line 1, then line 2, then
+//line 1 again (0x27 -> 0x40, 0x67 -> 0x00), so the cell after the last one is cell 0.
+#define CELLS	(LCD_FRAMEBUFFER_LINES * LCD_FRAMEBUFFER_COLUMNS)
+
+static inline uint8_t NextCell(uint8_t cell)
+{
+	return (cell + 1) % CELLS;
+}
+
+static inline uint8_t CellDirty(uint8_t cell)
+{
+	return (dirty[cell / LCD_FRAMEBUFFER_COLUMNS] >> (cell % LCD_FRAMEBUFFER_COLUMNS)) & 1;
+}
+
+//Instructions sent by the running flush. Address sets and return home the state cache skips (LCD_STATE_CACHE)
+//aren't counted.
+static uint32_t sent;
+
+//Moves the address counter to the given cell.
+static void SendAddress(uint8_t cell)
+{
+	uint32_t elided = LCD_ElidedInstructions();
+	SetDDRAMAddress(LINE_START_ADDRESS[cell / LCD_FRAMEBUFFER_COLUMNS] + (cell % LCD_FRAMEBUFFER_COLUMNS));
+	sent += (LCD_ElidedInstructions() == elided);
+}
+
+//Moves the address counter to cell 0 and the display back, which is only done when it isn't shifted.
+static void SendHome(void)
+{
+	uint32_t elided = LCD_ElidedInstructions();
+	ReturnHome();
+	sent += (LCD_ElidedInstructions() == elided);
+}
+
+//Writes the front buffer's character of the given cell at the address counter, which has to be at the cell.
+static void SendCell(uint8_t cell)
+{
+	sent++;
+	uint8_t line = cell / LCD_FRAMEBUFFER_COLUMNS;
+	uint8_t column = cell % LCD_FRAMEBUFFER_COLUMNS;
+	char character = buffers[front][line][column];
+	SendByte((uint8_t)character);
+	shown[line][column] = character;
+	dirty[line] &= ~(1ull << column);
+}
+
+//Cell the address counter is at according to the driver, CELLS if it isn't known or not in this framebuffer.
+static uint8_t CursorCell(void)
+{
+	uint8_t line;
+	uint8_t position;
+	if (!GetCursorPosition(&line, &position))
+	{
+		return CELLS;
+	}
+	//Lines 3 and 4 of a 40x4 module are lines 1 and 2 of their controller, positions count from the current page
+	uint8_t column = (LCD_GetColumnOrigin() + position - 1) % LCD_FRAMEBUFFER_COLUMNS;
+	return ((line - 1) % LCD_FRAMEBUFFER_LINES) * LCD_FRAMEBUFFER_COLUMNS + column;
+}
+
+//Number of clean cells from the given cell on until the next dirty one, CELLS if there is none.
+static uint8_t CleanCellsFrom(uint8_t cell)
+{
+	for (uint8_t count = 0; count < CELLS; count++, cell = NextCell(cell))
+	{
+		if (CellDirty(cell))
+		{
+			return count;
+		}
+	}
+	return CELLS;
+}
+
+//What the instructions the flush chooses between cost, in CPU cycles.
+typedef struct
+{
+	uint32_t address;
+	uint32_t write;
+	uint32_t home;
+	uint32_t clear;
+} Costs;
+
+static void GetCosts(Costs* costs)
+{
+	costs->address = LCD_ExpectedCycles(LCD_INSTRUCTION_SET_DDRAM_ADDRESS);
+	costs->write = LCD_ExpectedCycles(LCD_INSTRUCTION_WRITE_DATA);
+	costs->home = LCD_ExpectedCycles(LCD_INSTRUCTION_RETURN_HOME);
+	costs->clear = LCD_ExpectedCycles(LCD_INSTRUCTION_CLEAR_DISPLAY);
+}
+
+//Whether clean cells between two dirty ones are cheaper to write again than to jump over with an address set.
+static inline uint8_t BridgeCheaper(const Costs* costs, uint8_t cleanCells)
+{
+	return (uint32_t)cleanCells * costs->write < costs->address;
+}
+
+//How the address counter gets to the first cell of a plan.
+typedef enum
+{
+	START_AT_CURSOR,	//It is there already
+	START_BRIDGE,		//Writing the clean cells from the cursor on
+	START_ADDRESS,		//An address set
+	START_HOME,			//Return home, for cell 0
+} StartAction;
+
+//Plans the cheapest way to write every dirty cell, given where the address counter is (cursor, CELLS if unknown)
+//and whether return home may be used. Between two dirty cells, the clean cells are either written again or jumped
+//over with an address set, whichever is cheaper. The cells are written in address counter order, going around through
+//the line wraps, starting after the gap where jumping saves the most. Returns the cost in CPU cycles. When execute is
+//set, the plan is sent as well.
+static uint32_t Plan(const Costs* costs, uint8_t cursor, uint8_t homeAllowed, uint8_t execute)
+{
+	uint32_t total = 0;
+	//Cost of reaching each dirty cell from the dirty cell before it, and the best place to start
+	uint8_t start = CELLS;
+	int32_t bestSaving = INT32_MIN;
+	StartAction bestAction = START_ADDRESS;
+	uint8_t cell = 0;
+	while (cell < CELLS && !CellDirty(cell))
+	{
+		cell++;
+	}
+	if (cell == CELLS)
+	{
+		return 0;
+	}
+	uint8_t first = cell;
+	do
+	{
+		uint8_t clean = CleanCellsFrom(NextCell(cell));
+		uint8_t next = (cell + 1 + clean) % CELLS;
+		//Reaching next from cell: bridge or jump
+		uint32_t gapCost = (clean == 0) ? 0 : BridgeCheaper(costs, clean) ? clean * costs->write : costs->address;
+		total += gapCost + costs->write;
+
+		//Starting at next instead: the gap before it is not crossed, the start action is paid instead
+		uint32_t startCost = costs->address;
+		StartAction action = START_ADDRESS;
+		uint8_t fromCursor = (cursor < CELLS) ? (next + CELLS - cursor) % CELLS : CELLS;
+		if (fromCursor == 0)
+		{
+			startCost = 0;
+			action = START_AT_CURSOR;
+		}
+		else if (fromCursor <= clean && BridgeCheaper(costs, fromCursor))
+		{
+			//The cursor is in the gap, only clean cells are in between
+			startCost = fromCursor * costs->write;
+			action = START_BRIDGE;
+		}
+		else if (next == 0 && homeAllowed && costs->home < costs->address)
+		{
+			startCost = costs->home;
+			action = START_HOME;
+		}
+		int32_t saving = (int32_t)gapCost - (int32_t)startCost;
+		if (saving > bestSaving)
+		{
+			bestSaving = saving;
+			start = next;
+			bestAction = action;
+		}
+		cell = next;
+	} while (cell != first);
+	total -= bestSaving;
+
+	if (execute)
+	{
+		switch (bestAction)
+		{
+		case START_AT_CURSOR:
+			break;
+		case START_BRIDGE:
+			for (cell = cursor; cell != start; cell = NextCell(cell))
+			{
+				SendCell(cell);
+			}
+			break;
+		case START_ADDRESS:
+			SendAddress(start);
+			break;
+		case START_HOME:
+			SendHome();
+			break;
+		}
+		cell = start;
+		while (1)
+		{
+			SendCell(cell);
+			cell = NextCell(cell);
+			uint8_t clean = CleanCellsFrom(cell);
+			if (clean == CELLS)
+			{
+				break; //Everything sent
+			}
+			if (clean > 0 && !BridgeCheaper(costs, clean))
+			{
+				cell = (cell + clean) % CELLS;
+				SendAddress(cell);
+			}
+		}
+	}
+	return total;
+}
+
+//Starts a new frame once one has been committed. A commit from here on only changes the back buffer, the frame being
+//sent stays whole.
+static void TakeCommit(void)
+{
+	if (committed)
+	{
+		committed = 0;
+		Diff();
+		for (uint8_t line = 0; line < LCD_FRAMEBUFFER_LINES; line++)
+		{
+			unknown[line] = 0;
+		}
+	}
+}
+
+uint32_t LCD_Flush(void)
+{
+	sent = 0;
+	TakeCommit();
+	Costs costs;
+	GetCosts(&costs);
+	uint8_t cursor = CursorCell();
+	//Return home and clear move the display back and end page flipping (BeginHiddenPage), only an unshifted display
+	//showing the page at column 0 can use them
+	uint8_t shift;
+	uint8_t unshifted = LCD_GetDisplayShift(&shift) && shift == 0 && LCD_GetColumnOrigin() == 0;
+	uint32_t cost = Plan(&costs, cursor, unshifted, 0);
+	if (cost == 0)
+	{
+		return 0;
+	}
+
+	//The alternative: clear, then write everything that isn't a space
+	uint64_t keep[LCD_FRAMEBUFFER_LINES];
+	uint64_t cleared[LCD_FRAMEBUFFER_LINES];
+	if (unshifted)
+	{
+		for (uint8_t line = 0; line < LCD_FRAMEBUFFER_LINES; line++)
+		{
+			cleared[line] = 0;
+			for (uint8_t column = 0; column < LCD_FRAMEBUFFER_COLUMNS; column++)
+			{
+				if (buffers[front][line][column] != ' ')
+				{
+					cleared[line] |= 1ull << column;
+				}
+			}
+			keep[line] = dirty[line];
+			dirty[line] = cleared[line];
+		}
+		if (costs.clear + Plan(&costs, 0, 1, 0) < cost)
+		{
+			sent++; //Clearing is never skipped
+			ClearScreen();
+			memset(shown, ' ', sizeof(shown));
+			Plan(&costs, 0, 1, 1);
+			return sent;
+		}
+		memcpy(dirty, keep, sizeof(dirty));
+	}
+	Plan(&costs, cursor, unshifted, 1);
+	return sent;
+}
+
+//Finds the dirty cell that has been waiting the longest (the first one in DDRAM order among equals) and returns the
+//start of the run of dirty cells it is in. Returns CELLS if nothing is dirty.
+static uint8_t OldestRun(void)
+{
+	uint8_t oldestCell = CELLS;
+	uint32_t oldest = 0;
+	for (uint8_t l = 0; l < LCD_FRAMEBUFFER_LINES; l++)
+	{
+		for (uint64_t bits = dirty[l]; bits != 0; bits &= bits - 1)
+		{
+			uint8_t c = __builtin_ctzll(bits);
+			if (oldestCell == CELLS || (int32_t)(dirtySince[l][c] - oldest) < 0)
+			{
+				oldest = dirtySince[l][c];
+				oldestCell = l * LCD_FRAMEBUFFER_COLUMNS + c;
+			}
+		}
+	}
+	if (oldestCell == CELLS)
+	{
+		return CELLS;
+	}
+	//The newer cells before it in the same run come along for free, they need no address set of their own
+	uint8_t cell = oldestCell;
+	for (uint8_t i = 0; i < CELLS; i++)
+	{
+		uint8_t previous = (cell + CELLS - 1) % CELLS;
+		if (!CellDirty(previous) || previous == oldestCell)
+		{
+			break;
+		}
+		cell = previous;
+	}
+	return cell;
+}
+
+uint32_t LCD_FlushFor(uint32_t microseconds)
+{
+	uint32_t start = LCD_Now();
+	uint64_t budget64 = (uint64_t)microseconds * lcdTiming.cyclesPerMicrosecond;
+	uint32_t budget = (budget64 < UINT32_MAX) ? (uint32_t)budget64 : UINT32_MAX;
+	TakeCommit();
+	//Every instruction is counted with the time it is expected to keep the chip busy, which is about what it adds to
+	//the call when the driver waits for the chip. With LCD_ASYNC the call takes less than that.
+	Costs costs;
+	GetCosts(&costs);
+
+	sent = 0;
+	uint8_t cursor = CursorCell();
+	uint8_t cell;
+	while ((cell = OldestRun()) != CELLS)
+	{
+		if ((LCD_Now() - start) + costs.write + ((cursor != cell) ? costs.address : 0) > budget)
+		{
+			return sent; //The rest is sent by the next call
+		}
+		if (cursor != cell)
+		{
+			SendAddress(cell);
+		}
+		//The run, and the ones after it as long as the clean cells in between are cheaper to write than to jump over
+		while (1)
+		{
+			SendCell(cell);
+			cell = NextCell(cell);
+			cursor = cell;
+			uint8_t clean = CleanCellsFrom(cell);
+			if (clean == CELLS || (clean > 0 && !BridgeCheaper(&costs, clean)))
+			{
+				break;
+			}
+			if ((LCD_Now() - start) + (clean + 1) * costs.write > budget)
+			{
+				return sent;
+			}
+			for (; clean > 0; clean--, cell = NextCell(cell), cursor = cell)
+			{
+				SendCell(cell);
+			}
+		}
+	}
+	return sent;
+}
+
+#if LCD_ENABLE_BENCHMARK
+uint32_t LCD_FlushRuns(void)
+{
+	sent = 0;
+	TakeCommit();
+	for (uint8_t cell = 0; cell < CELLS; cell++)
+	{
+		if (CellDirty(cell))
+		{
+			SendAddress(cell);
+			for (; cell < CELLS && CellDirty(cell); cell++)
+			{
+				SendCell(cell);
+			}
+		}
+	}
+	return sent;
+}
+#endif
+
+#endif /* LCD_FRAMEBUFFER */
@@ -0,0 +1,240 @@
+/*
+ * lcd_handle.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_handle.h>
+
+#if LCD_HANDLES
+
+#include "lcd_HD44780U_internal.h"
+#include <lcd_async.h>
+
+_Static_assert((LCD_HANDLE_QUEUE_SIZE & (LCD_HANDLE_QUEUE_SIZE - 1)) == 0, "LCD_HANDLE_QUEUE_SIZE must be a power of 2");
+
+static const uint16_t CLEAR_DISPLAY = 0b0000000001;
+static const uint16_t RETURN_HOME = 0b0000000010;
+static const uint16_t ENTRY_MODE_SET = 0b0000000100;
+static const uint16_t DISPLAY_CONTROL = 0b0000001000;
+static const uint16_t FUNCTION_SET = 0b0000100000;
+static const uint16_t SET_DDRAM_ADDRESS = 0b0010000000;
+static const uint16_t WRITE_DATA = 0b1000000000;
+
+//Every handle that has been set up, in the order of LCD_Handle_Init.
+static LCD_Handle* handles;
+//Where the next LCD_Handles_Service starts, so no handle is always served first.
+static LCD_Handle* nextHandle;
+
+static void Register(LCD_Handle* handle)
+{
+	for (LCD_Handle* h = handles; h != NULL; h = h->next)
+	{
+		if (h == handle)
+		{
+			return; //Set up again
+		}
+	}
+	handle->next = handles;
+	handles = handle;
+	nextHandle = handles;
+}
+
+//Queues the instruction without checking for room, the callers do.
+static void Put(LCD_Handle* handle, uint16_t instruction)
+{
+	handle->queue[handle->head & (LCD_HANDLE_QUEUE_SIZE - 1)] = instruction;
+	handle->head++;
+}
+
+uint8_t LCD_Handle_Init(LCD_Handle* handle, uint8_t display, uint8_t columns, uint8_t lines)
+{
+	if (display < 1 || display > LCD_DISPLAY_COUNT)
+	{
+		return 0;
+	}
+	handle->display = display;
+	handle->columns = columns;
+	handle->lines = lines;
+	for (size_t i = 0; i < arr_size(handle->executionCycles); i++)
+	{
+		handle->executionCycles[i] = LCD_ExecutionCycles((LCD_InstructionClass)i);
+	}
+	LCD_SetDisplayExecutionCycles(display - 1, handle->executionCycles);
+	handle->head = 0;
+	handle->tail = 0;
+	Register(handle);
+
+	//8-bit mode, 1 line only for single line modules (20x4 and 16x4 are 2-line controllers as well)
+	Put(handle, FUNCTION_SET | (1 << 4) | ((lines > 1) ? (1 << 3) : 0));
+	LCD_Handle_DisplayAndCursorControl(handle, 1, 0, 0);
+	LCD_Handle_EntryModeSet(handle, 1, 0);
+	LCD_Handle_ClearScreen(handle);
+	return 1;
+}
+
+void LCD_Handle_SetExecutionTime(LCD_Handle* handle, LCD_InstructionClass instructionClass, uint32_t microseconds)
+{
+	if (instructionClass >= LCD_INSTRUCTION_CLASS_COUNT)
+	{
+		return;
+	}
+	handle->executionCycles[instructionClass] = microseconds * lcdTiming.cyclesPerMicrosecond;
+}
+
+size_t LCD_Handle_FreeSlots(const LCD_Handle* handle)
+{
+	return LCD_HANDLE_QUEUE_SIZE - (handle->head - handle->tail);
+}
+
+uint8_t LCD_Handle_IsIdle(const LCD_Handle* handle)
+{
+	return handle->head == handle->tail;
+}
+
+uint8_t LCD_Handle_Enqueue(LCD_Handle* handle, uint16_t instruction)
+{
+	if (LCD_Handle_FreeSlots(handle) == 0)
+	{
+		return 0;
+	}
+	Put(handle, instruction);
+	return 1;
+}
+
+uint8_t LCD_Handle_ClearScreen(LCD_Handle* handle)
+{
+	return LCD_Handle_Enqueue(handle, CLEAR_DISPLAY);
+}
+
+uint8_t LCD_Handle_ReturnHome(LCD_Handle* handle)
+{
+	return LCD_Handle_Enqueue(handle, RETURN_HOME);
+}
+
+uint8_t LCD_Handle_EntryModeSet(LCD_Handle* handle, uint8_t increment, uint8_t shiftDisplay)
+{
+	return LCD_Handle_Enqueue(handle, ENTRY_MODE_SET | (increment ? (1 << 1) : 0) | (shiftDisplay ? (1 << 0) : 0));
+}
+
+uint8_t LCD_Handle_DisplayAndCursorControl(LCD_Handle* handle, uint8_t display, uint8_t cursor, uint8_t blink)
+{
+	uint16_t instruction = DISPLAY_CONTROL | (display ? (1 << 2) : 0) | (cursor ? (1 << 1) : 0) | (blink ? (1 << 0) : 0);
+	return LCD_Handle_Enqueue(handle, instruction);
+}
+
+//DDRAM address of the given line and position, clamped to the handle's geometry. Lines 3 and 4 of a 4-line module
+//continue lines 1 and 2 of the controller right after their visible part.
+static uint8_t Address(const LCD_Handle* handle, uint8_t line, uint8_t position)
+{
+	static const uint8_t lineStart[4] = { 0x00, 0x40, 0x00, 0x40 };
+
+	if (line < 1)
+	{
+		line = 1;
+	}
+	else if (line > handle->lines)
+	{
+		line = handle->lines;
+	}
+
+	//A 1-line controller has one 80 character line
+	uint8_t lineLength = (handle->lines == 1) ? 80 : 40;
+	if (position < 1)
+	{
+		position = 1;
+	}
+	else if (position > lineLength)
+	{
+		position = lineLength;
+	}
+
+	uint8_t address = lineStart[line - 1] + position - 1;
+	if (line > 2)
+	{
+		address += handle->columns;
+	}
+	return address & 0x7F;
+}
+
+uint8_t LCD_Handle_MoveCursor(LCD_Handle* handle, uint8_t line, uint8_t position)
+{
+	return LCD_Handle_Enqueue(handle, SET_DDRAM_ADDRESS | Address(handle, line, position));
+}
+
+uint8_t LCD_Handle_Write(LCD_Handle* handle, const char* text, size_t len)
+{
+	if (LCD_Handle_FreeSlots(handle) < len)
+	{
+		return 0;
+	}
+	for (size_t i = 0; i < len; i++)
+	{
+		Put(handle, WRITE_DATA | (uint8_t)text[i]);
+	}
+	return 1;
+}
+
+uint8_t LCD_Handle_WriteAt(LCD_Handle* handle, uint8_t line, uint8_t position, const char* text, size_t len)
+{
+	if (LCD_Handle_FreeSlots(handle) < len + 1)
+	{
+		return 0;
+	}
+	LCD_Handle_MoveCursor(handle, line, position);
+	return LCD_Handle_Write(handle, text, len);
+}
+
+uint32_t LCD_Handles_Service(void)
+{
+	if (handles == NULL)
+	{
+		return 0;
+	}
+#if LCD_ASYNC
+	LCD_Async_Flush(); //The interrupt stays off the bus until something is queued again
+#endif
+
+	//One instruction per handle and pass, as long as some display takes one. A display that is still busy is skipped
+	//and the bus goes to the next one instead of waiting, so N displays take up to N times as many instructions per
+	//second as one.
+	uint32_t sent = 0;
+	uint32_t sentInPass;
+	do
+	{
+		sentInPass = 0;
+		LCD_Handle* handle = nextHandle;
+		do
+		{
+			if (handle->head != handle->tail && LCD_DisplayReady(handle->display - 1))
+			{
+				LCD_WriteDisplay(handle->display - 1, handle->queue[handle->tail & (LCD_HANDLE_QUEUE_SIZE - 1)]);
+				handle->tail++;
+				sentInPass++;
+			}
+			handle = (handle->next != NULL) ? handle->next : handles;
+		} while (handle != nextHandle);
+		sent += sentInPass;
+	} while (sentInPass > 0);
+
+	nextHandle = (nextHandle->next != NULL) ? nextHandle->next : handles;
+	return sent;
+}
+
+void LCD_Handles_Flush(void)
+{
+	for (LCD_Handle* handle = handles; handle != NULL; )
+	{
+		if (LCD_Handle_IsIdle(handle))
+		{
+			handle = handle->next;
+		}
+		else
+		{
+			LCD_Handles_Service();
+		}
+	}
+}
+
+#endif /* LCD_HANDLES */
@@ -0,0 +1,175 @@
+/*
+ * lcd_marquee.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_marquee.h>
+
+#if LCD_MARQUEE
+
+#include <lcd_HD44780U.h>
+#include "main.h"
+#include <string.h>
+
+#define MARQUEE_LINES		2
+#define RING_COLUMNS		40
+
+//DDRAM address of the first character of each line.
+static const uint8_t LINE_START_ADDRESS[MARQUEE_LINES] = { 0x00, 0x40 };
+static const uint64_t ALL_COLUMNS = (1ull << RING_COLUMNS) - 1;
+//No scrolling line leads the display shift.
+static const uint8_t NO_LEAD = MARQUEE_LINES;
+
+typedef struct
+{
+	const char* text;
+	size_t len;
+	uint32_t periodMs;
+	size_t offset;		//Character of text at the left edge of the window
+	uint32_t due;		//HAL_GetTick of the next step
+} MarqueeLine;
+
+static MarqueeLine lines[MARQUEE_LINES];
+static uint8_t windowColumns;
+//Display shift in positions to the left: the DDRAM column at the left edge of the window.
+static uint8_t shift;
+//The line whose steps shift the display.
+static uint8_t lead = NO_LEAD;
+//Set when a line has changed and everything needs to be compared again.
+static uint8_t redraw;
+
+//What the DDRAM holds, and bit n of a line set when column n of it isn't known.
+static char ddram[MARQUEE_LINES][RING_COLUMNS];
+static uint64_t unknown[MARQUEE_LINES];
+
+static void ChooseLead(void)
+{
+	lead = NO_LEAD;
+	for (uint8_t line = 0; line < MARQUEE_LINES; line++)
+	{
+		if (lines[line].periodMs != 0 && lines[line].len != 0
+			&& (lead == NO_LEAD || lines[line].periodMs < lines[lead].periodMs))
+		{
+			lead = line;
+		}
+	}
+}
+
+void LCD_Marquee_Init(uint8_t columns)
+{
+	windowColumns = (columns < 1) ? 1 : (columns > RING_COLUMNS - 1) ? RING_COLUMNS - 1 : columns;
+	memset(lines, 0, sizeof(lines));
+	lead = NO_LEAD;
+	shift = 0;
+	EntryModeSet(1, 0);
+	ReturnHome();
+	unknown[0] = ALL_COLUMNS;
+	unknown[1] = ALL_COLUMNS;
+	redraw = 1;
+}
+
+void LCD_Marquee_SetLine(uint8_t line, const char* text, size_t len, uint32_t periodMs)
+{
+	if (line < 1 || line > MARQUEE_LINES)
+	{
+		return;
+	}
+	MarqueeLine* l = &lines[line - 1];
+	l->text = text;
+	l->len = (text != NULL) ? len : 0;
+	l->periodMs = periodMs;
+	l->offset = 0;
+	l->due = HAL_GetTick() + periodMs;
+	ChooseLead();
+	redraw = 1;
+}
+
+//The character the given DDRAM column of a line should hold, or -1 if it doesn't matter: columns outside the window
+//only matter for the leading line, which has the whole ring filled ahead of the window. Character 0 is the first
+//CGRAM glyph.
+static int16_t WantedChar(uint8_t line, uint8_t column)
+{
+	const MarqueeLine* l = &lines[line];
+	uint8_t distance = (column + RING_COLUMNS - shift) % RING_COLUMNS; //From the left edge of the window
+	if (distance >= windowColumns && line != lead)
+	{
+		return -1;
+	}
+	if (l->len == 0)
+	{
+		return ' ';
+	}
+	if (l->periodMs == 0)
+	{
+		return (distance < l->len) ? (uint8_t)l->text[distance] : ' ';
+	}
+	return (uint8_t)l->text[(l->offset + distance) % l->len];
+}
+
+//Writes every column that differs from what it should hold, from the left edge of the window on. Returns the number
+//of instructions sent.
+static uint32_t Render(void)
+{
+	uint32_t sent = 0;
+	for (uint8_t line = 0; line < MARQUEE_LINES; line++)
+	{
+		uint8_t next = 0xFF; //DDRAM address the cursor moves to, if it is on this line
+		for (uint8_t i = 0; i < RING_COLUMNS; i++)
+		{
+			uint8_t column = (shift + i) % RING_COLUMNS;
+			int16_t wanted = WantedChar(line, column);
+			if (wanted < 0 || ((uint8_t)ddram[line][column] == wanted && !(unknown[line] & (1ull << column))))
+			{
+				continue;
+			}
+			uint8_t address = LINE_START_ADDRESS[line] + column;
+			if (address != next)
+			{
+				SetDDRAMAddress(address);
+				sent++;
+			}
+			SendByte((uint8_t)wanted);
+			sent++;
+			ddram[line][column] = (char)wanted;
+			unknown[line] &= ~(1ull << column);
+			//The last column continues on the other line
+			next = (column == RING_COLUMNS - 1) ? 0xFF : address + 1;
+		}
+	}
+	return sent;
+}
+
+uint32_t LCD_Marquee_Service(void)
+{
+	uint32_t now = HAL_GetTick();
+	uint32_t sent = 0;
+	for (uint8_t line = 0; line < MARQUEE_LINES; line++)
+	{
+		MarqueeLine* l = &lines[line];
+		if (l->periodMs == 0 || l->len == 0 || (int32_t)(now - l->due) < 0)
+		{
+			continue;
+		}
+		//Steps that were missed are skipped rather than caught up with
+		l->due = ((now - l->due) >= l->periodMs) ? now + l->periodMs : l->due + l->periodMs;
+		l->offset = (l->offset + 1) % l->len;
+		if (line == lead)
+		{
+			ShiftDisplay(0);
+			shift = (shift + 1) % RING_COLUMNS;
+			sent++;
+		}
+		redraw = 1;
+	}
+
+	if (redraw)
+	{
+		redraw = 0;
+		sent += Render();
+	}
+	return sent;
+}
+
+#endif /* LCD_MARQUEE */
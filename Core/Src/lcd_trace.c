@@ -0,0 +1,230 @@
+/*
+ * lcd_trace.c
+ *
+ *  Created on: Jan 16, 2026
+ *      Author: ugklp
+ */
+
+#include <lcd_trace.h>
+
+#if LCD_TRACE
+
+#include "lcd_HD44780U_internal.h"
+#include "main.h"
+#include "usbd_cdc_if.h"
+#include <string.h>
+
+_Static_assert((LCD_TRACE_BUFFER_SIZE & (LCD_TRACE_BUFFER_SIZE - 1)) == 0, "LCD_TRACE_BUFFER_SIZE must be a power of 2");
+_Static_assert(sizeof(LCD_TraceRecord) == 12, "The host decoder expects 12 byte records");
+_Static_assert(sizeof(LCD_TraceHeader) == 20, "The host decoder expects a 20 byte header");
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+//How long a dump waits for the host to take a transfer.
+static const uint32_t USB_TIMEOUT_MS = 100;
+//Largest single CDC transfer, a multiple of the 64 byte packet size and of the record size.
+static const uint32_t USB_CHUNK_BYTES = 64 * 3 * 64;
+
+//Ring buffer, written is free running and the slot is the index modulo the buffer size. Once full, the oldest
+//records are overwritten.
+static LCD_TraceRecord records[LCD_TRACE_BUFFER_SIZE];
+static uint32_t written;
+
+static volatile uint8_t enabled = 1;
+static volatile uint8_t dumpRequested;
+
+//Wait accumulated for the next record.
+static uint32_t nextWaitCycles;
+static uint32_t nextPolls;
+static uint16_t nextFlags;
+
+void LCD_Trace_Enable(uint8_t enable)
+{
+	enabled = enable;
+}
+
+void LCD_Trace_Clear(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	written = 0;
+	nextWaitCycles = 0;
+	nextPolls = 0;
+	nextFlags = 0;
+	__set_PRIMASK(primask);
+}
+
+void LCD_Trace_Wait(uint32_t waitCycles, uint32_t polls, uint8_t timedOut)
+{
+	if (!enabled)
+	{
+		return;
+	}
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	nextWaitCycles += waitCycles;
+	nextPolls += polls;
+	if (timedOut)
+	{
+		nextFlags |= LCD_TRACE_FLAG_TIMEOUT;
+	}
+	__set_PRIMASK(primask);
+}
+
+void LCD_Trace_Access(uint16_t instruction, uint32_t cycles, uint16_t flags)
+{
+	if (!enabled)
+	{
+		return;
+	}
+	if (__get_IPSR() != 0)
+	{
+		flags |= LCD_TRACE_FLAG_INTERRUPT;
+	}
+
+	//The async interrupt records as well, so the slot has to be taken atomically.
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	LCD_TraceRecord* record = &records[written & (LCD_TRACE_BUFFER_SIZE - 1)];
+	written++;
+	record->cycles = cycles;
+	record->waitCycles = nextWaitCycles;
+	record->polls = (nextPolls > 0xFFFF) ? 0xFFFF : (uint16_t)nextPolls;
+	record->word = (instruction & LCD_TRACE_INSTRUCTION_MASK) | nextFlags | flags;
+	nextWaitCycles = 0;
+	nextPolls = 0;
+	nextFlags = 0;
+	__set_PRIMASK(primask);
+}
+
+//Returns the number of records in the buffer and the index of the oldest one.
+static uint32_t Stored(uint32_t* oldest)
+{
+	uint32_t count = (written < LCD_TRACE_BUFFER_SIZE) ? written : LCD_TRACE_BUFFER_SIZE;
+	*oldest = written - count;
+	return count;
+}
+
+uint32_t LCD_Trace_Read(LCD_TraceRecord* out, uint32_t maxRecords)
+{
+	uint8_t wasEnabled = enabled;
+	enabled = 0;
+
+	uint32_t oldest;
+	uint32_t count = Stored(&oldest);
+	if (count > maxRecords)
+	{
+		count = maxRecords;
+	}
+	for (uint32_t i = 0; i < count; i++)
+	{
+		out[i] = records[(oldest + i) & (LCD_TRACE_BUFFER_SIZE - 1)];
+	}
+
+	enabled = wasEnabled;
+	return count;
+}
+
+//Sends len bytes over CDC, waiting for the previous transfer to finish first. The buffer has to stay valid until the
+//next call, which is the case for the record buffer and the static header.
+static uint8_t Transmit(uint8_t* data, uint32_t len)
+{
+	uint32_t start = HAL_GetTick();
+	while (CDC_Transmit_FS(data, (uint16_t)len) == USBD_BUSY)
+	{
+		if ((HAL_GetTick() - start) > USB_TIMEOUT_MS)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//Waits until the host has taken the last transfer.
+static uint8_t WaitTransmitted(void)
+{
+	USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+	uint32_t start = HAL_GetTick();
+	while (hcdc->TxState != 0)
+	{
+		if ((HAL_GetTick() - start) > USB_TIMEOUT_MS)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//Sends count records starting at the given ring buffer slot, which must not wrap.
+static uint8_t TransmitRecords(uint32_t first, uint32_t count)
+{
+	uint8_t* data = (uint8_t*)&records[first];
+	uint32_t len = count * sizeof(LCD_TraceRecord);
+	while (len > 0)
+	{
+		uint32_t chunk = (len < USB_CHUNK_BYTES) ? len : USB_CHUNK_BYTES;
+		if (!Transmit(data, chunk))
+		{
+			return 0;
+		}
+		data += chunk;
+		len -= chunk;
+	}
+	return 1;
+}
+
+uint8_t LCD_Trace_Dump(void)
+{
+	static LCD_TraceHeader header;
+
+	if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED)
+	{
+		return 0;
+	}
+
+	uint8_t wasEnabled = enabled;
+	enabled = 0;
+
+	uint32_t oldest;
+	uint32_t count = Stored(&oldest);
+	memcpy(header.magic, LCD_TRACE_MAGIC, sizeof(header.magic));
+	header.version = LCD_TRACE_VERSION;
+	header.recordSize = sizeof(LCD_TraceRecord);
+	header.reserved = 0;
+	header.coreClockHz = lcdTiming.coreClockHz;
+	header.recordCount = count;
+	header.dropped = oldest;
+
+	//Oldest first: the part from the oldest slot to the end of the buffer, then the wrapped part.
+	uint32_t first = oldest & (LCD_TRACE_BUFFER_SIZE - 1);
+	uint32_t untilEnd = LCD_TRACE_BUFFER_SIZE - first;
+	uint32_t firstPart = (count < untilEnd) ? count : untilEnd;
+	uint8_t ok = Transmit((uint8_t*)&header, sizeof(header)) &&
+				 TransmitRecords(first, firstPart) &&
+				 TransmitRecords(0, count - firstPart);
+	//The last transfer reads from the buffer until it is done
+	ok = ok && WaitTransmitted();
+
+	if (ok)
+	{
+		LCD_Trace_Clear();
+	}
+	enabled = wasEnabled;
+	return ok;
+}
+
+void LCD_Trace_RequestDump(void)
+{
+	dumpRequested = 1;
+}
+
+void LCD_Trace_Process(void)
+{
+	if (dumpRequested)
+	{
+		dumpRequested = 0;
+		LCD_Trace_Dump();
+	}
+}
+
+#endif /* LCD_TRACE */
@@ -25,6 +25,7 @@
 /* USER CODE BEGIN Includes */
 #include <string.h>
 #include "usbd_cdc_if.h"
+#include <lcd_trace.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -63,6 +64,14 @@ void USBD_CDC_Receive(uint8_t* buf, uint32_t* len)
 	//other blocking operation or any heavy processing. For any of these, best course
 	//of action is to copy the result into a buffer and process it in main(). For light
 	//processing, doing it in this function is fine.
+#if LCD_TRACE
+	//A single 'T' asks for the LCD bus trace (see Tools/lcd_trace_decode.py)
+	if (*len == 1 && buf[0] == 'T')
+	{
+		LCD_Trace_RequestDump();
+		return;
+	}
+#endif
 	CDC_Transmit_FS(buf, *len);
 }
 
@@ -112,6 +121,9 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
+#if LCD_TRACE
+    LCD_Trace_Process();
+#endif
   }
   /* USER CODE END 3 */
 }
@@ -22,6 +22,8 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include <lcd_async.h>
+#include <lcd_burst.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -213,5 +215,24 @@ void OTG_FS_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
+#if LCD_ASYNC
+/**
+  * @brief This function handles TIM7 global interrupt, which drives the LCD instruction queue.
+  */
+void TIM7_IRQHandler(void)
+{
+  LCD_Async_TimerIRQHandler();
+}
+#endif
+
+#if LCD_BURST
+/**
+  * @brief This function handles DMA2 stream2 global interrupt, which ends LCD bursts.
+  */
+void DMA2_Stream2_IRQHandler(void)
+{
+  LCD_Burst_DMAIRQHandler();
+}
+#endif
 
 /* USER CODE END 1 */
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+#
+# lcd_trace_decode.py
+#
+# Reads an LCD bus trace (LCD_TRACE, see Core/Inc/lcd_trace.h) from the board's USB CDC port or from a file saved
+# earlier, and prints a timeline, the instruction mix and latency histograms per instruction class.
+#
+# Usage:
+#   lcd_trace_decode.py /dev/ttyACM0              request a dump from the board and decode it
+#   lcd_trace_decode.py /dev/ttyACM0 -s run.bin   also save the raw dump
+#   lcd_trace_decode.py run.bin                   decode a saved dump
+#
+# Only the Python 3 standard library is needed.
+
+import argparse
+import os
+import select
+import stat
+import struct
+import sys
+import termios
+import tty
+
+MAGIC = b"LCDT"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHIII")
+RECORD = struct.Struct("<IIHH")
+
+INSTRUCTION_MASK = 0x03FF
+FLAG_TIMEOUT = 1 << 10
+FLAG_INTERRUPT = 1 << 11
+FLAG_BURST = 1 << 12
+
+# Same order as LCD_InstructionClass
+CLASSES = ["clear", "home", "entry", "display", "shift", "function", "cgram", "ddram", "write", "read"]
+
+
+def classify(instruction):
+    if instruction & (1 << 9):
+        return "read" if instruction & (1 << 8) else "write"
+    if instruction & (1 << 8):
+        return "status"  # Busy flag / address counter read
+    byte = instruction & 0xFF
+    if byte == 0:
+        return "clear"
+    return CLASSES[byte.bit_length() - 1]
+
+
+def describe(instruction):
+    byte = instruction & 0xFF
+    kind = classify(instruction)
+    if kind in ("write", "read"):
+        text = chr(byte) if 0x20 <= byte < 0x7F else "."
+        return "%-5s 0x%02X '%s'" % (kind.upper(), byte, text)
+    if kind == "status":
+        return "STATUS BF=%d AC=0x%02X" % (byte >> 7, byte & 0x7F)
+    if kind == "clear":
+        return "CLEAR"
+    if kind == "home":
+        return "HOME"
+    if kind == "entry":
+        return "ENTRY %s%s" % ("inc" if byte & 0x02 else "dec", " shift" if byte & 0x01 else "")
+    if kind == "display":
+        return "DISPLAY D=%d C=%d B=%d" % ((byte >> 2) & 1, (byte >> 1) & 1, byte & 1)
+    if kind == "shift":
+        return "SHIFT %s %s" % ("display" if byte & 0x08 else "cursor", "right" if byte & 0x04 else "left")
+    if kind == "function":
+        return "FUNCTION DL=%d N=%d F=%d" % ((byte >> 4) & 1, (byte >> 3) & 1, (byte >> 2) & 1)
+    if kind == "cgram":
+        return "CGRAM 0x%02X" % (byte & 0x3F)
+    return "DDRAM 0x%02X" % (byte & 0x7F)
+
+
+def read_exact(fd, length, timeout):
+    data = b""
+    while len(data) < length:
+        ready, _, _ = select.select([fd], [], [], timeout)
+        if not ready:
+            raise TimeoutError("the board stopped sending after %d of %d bytes" % (len(data), length))
+        chunk = os.read(fd, length - len(data))
+        if not chunk:
+            raise EOFError("unexpected end of data")
+        data += chunk
+    return data
+
+
+def read_from_device(path, timeout):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    try:
+        tty.setraw(fd)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+        os.write(fd, b"T")
+        header = read_exact(fd, HEADER.size, timeout)
+        count = HEADER.unpack(header)[5]
+        return header + read_exact(fd, count * RECORD.size, timeout)
+    finally:
+        os.close(fd)
+
+
+def parse(data):
+    if len(data) < HEADER.size:
+        sys.exit("too short for a trace header")
+    magic, version, record_size, _, clock, count, dropped = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or record_size != RECORD.size:
+        sys.exit("not an LCD trace (magic %r, version %d, record size %d)" % (magic, version, record_size))
+    if len(data) < HEADER.size + count * RECORD.size:
+        sys.exit("truncated trace: %d records announced" % count)
+    records = [RECORD.unpack_from(data, HEADER.size + i * RECORD.size) for i in range(count)]
+    return clock, dropped, records
+
+
+def us(cycles, clock):
+    return cycles * 1e6 / clock
+
+
+def print_timeline(records, clock):
+    print("%12s %10s %10s %6s  %-28s %s" % ("time us", "delta us", "wait us", "polls", "access", "flags"))
+    start = records[0][0]
+    previous = start
+    for cycles, wait, polls, word in records:
+        flags = []
+        if word & FLAG_TIMEOUT:
+            flags.append("TIMEOUT")
+        if word & FLAG_INTERRUPT:
+            flags.append("irq")
+        if word & FLAG_BURST:
+            flags.append("dma")
+        # Cycle stamps are 32 bits and wrap, differences are taken modulo 2^32
+        print("%12.2f %10.2f %10.2f %6d  %-28s %s" % (us((cycles - start) & 0xFFFFFFFF, clock),
+                                                      us((cycles - previous) & 0xFFFFFFFF, clock),
+                                                      us(wait, clock), polls, describe(word & INSTRUCTION_MASK),
+                                                      " ".join(flags)))
+        previous = cycles
+
+
+def print_mix(records, clock):
+    # The wait in a record is the wait for the access before it, so it's charged to that access.
+    stats = {}
+    for i, (cycles, _, _, word) in enumerate(records):
+        kind = classify(word & INSTRUCTION_MASK)
+        entry = stats.setdefault(kind, [0, 0, 0])
+        entry[0] += 1
+        if i + 1 < len(records):
+            entry[1] += records[i + 1][1]
+            entry[2] += records[i + 1][2]
+    total = len(records)
+    total_wait = sum(entry[1] for entry in stats.values()) or 1
+    print("%-10s %8s %7s %12s %7s %10s" % ("class", "count", "share", "wait us", "share", "polls"))
+    for kind, (count, wait, polls) in sorted(stats.items(), key=lambda item: -item[1][0]):
+        print("%-10s %8d %6.1f%% %12.1f %6.1f%% %10d" % (kind, count, 100.0 * count / total, us(wait, clock),
+                                                         100.0 * wait / total_wait, polls))
+
+
+def histogram(values, width=40):
+    # Power of 2 buckets in microseconds
+    buckets = {}
+    for value in values:
+        bucket = 0
+        while (1 << bucket) <= value:
+            bucket += 1
+        buckets[bucket] = buckets.get(bucket, 0) + 1
+    largest = max(buckets.values())
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        low = 0 if bucket == 0 else 1 << (bucket - 1)
+        print("  %6d-%-6d us %7d %s" % (low, (1 << bucket) - 1, count, "#" * (count * width // largest)))
+
+
+def print_latencies(records, clock):
+    # Latency of an access: from its strobe until the next access could be strobed, i.e. the bus time it took.
+    latencies = {}
+    for i in range(len(records) - 1):
+        kind = classify(records[i][3] & INSTRUCTION_MASK)
+        delta = (records[i + 1][0] - records[i][0]) & 0xFFFFFFFF
+        latencies.setdefault(kind, []).append(us(delta, clock))
+    for kind, values in sorted(latencies.items(), key=lambda item: -len(item[1])):
+        values.sort()
+        print("%s: n=%d min=%.1f median=%.1f p99=%.1f max=%.1f us" % (kind, len(values), values[0],
+                                                                      values[len(values) // 2],
+                                                                      values[min(len(values) - 1,
+                                                                                 len(values) * 99 // 100)],
+                                                                      values[-1]))
+        histogram(values)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode an LCD bus trace")
+    parser.add_argument("source", help="CDC device (e.g. /dev/ttyACM0) or a saved dump")
+    parser.add_argument("-s", "--save", help="also write the raw dump to this file")
+    parser.add_argument("-t", "--timeout", type=float, default=2.0, help="device read timeout in seconds")
+    parser.add_argument("--no-timeline", action="store_true", help="only print the summaries")
+    args = parser.parse_args()
+
+    if stat.S_ISCHR(os.stat(args.source).st_mode):
+        data = read_from_device(args.source, args.timeout)
+    else:
+        with open(args.source, "rb") as file:
+            data = file.read()
+    if args.save:
+        with open(args.save, "wb") as file:
+            file.write(data)
+
+    clock, dropped, records = parse(data)
+    print("%d records at %.1f MHz, %d older records were overwritten" % (len(records), clock / 1e6, dropped))
+    if not records:
+        return
+    if not args.no_timeline:
+        print()
+        print_timeline(records, clock)
+    print()
+    print_mix(records, clock)
+    print()
+    print_latencies(records, clock)
+
+
+if __name__ == "__main__":
+    main()